@@ -19,43 +19,96 @@
 #include <string.h>
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <csignal>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
 #include <vector>
 
+#include "FeatureSelector.h"
 #include "MutualInfo.h"
+#include "MutualInfoMatrix.h"
+#include "Parallel.h"
 #include "RawData.h"
-
-// Returns the index of the higher value in the classRelevances Vector different
-// from classIndex
-std::uint32_t getMaxRelevance(std::vector<double> classRelevances, std::uint32_t classIndex)
-{
-    std::uint32_t i = 0;
-    std::uint32_t newFeature = -1;
-    double relevance = 0;
-    for (i = 0; i < classRelevances.size(); ++i) {
-        if (classRelevances[i] > relevance && i != classIndex) {
-            relevance = classRelevances[i];
-            newFeature = i;
-        }
-    }
-    return newFeature;
-}
+#include "Sidecar.h"
+#include "Stats.h"
+#include "SubsetSelector.h"
+#include "Workspace.h"
 
 typedef struct options {
     std::uint32_t classIndex;
     std::uint32_t selectedFeatures;
     std::string file;
+    std::string statsFile;
+    std::string cacheFile;
+    std::string matrixFile;
+    std::uint32_t folds;
+    std::uint32_t bootstraps;
+    std::uint64_t seed;
+    double budgetMs;
+    std::string checkpointFile;
+    double checkpointIntervalS;
+    bool stream;
+    bool listSkipped;
+    bool cache;
+    Criterion criterion;
+    std::uint32_t threads;
+    LoadOptions load;
 } options;
 
+// Prints the command line options to stdout.
+void printUsage()
+{
+    printf(
+        "fast-mrmr:\nOptions:\n -f <inputfile>\t\tMRMR file generated "
+        "using mrmrReader (default: data.mrmr).\n-c "
+        "<classindex>\t\tIndicates the class index in the dataset "
+        "(default: 0).\n-a <nfeatures>\t Indicates the number of "
+        "features to select (default: 10).\n-t <threads>\t Number of worker "
+        "threads (default: all hardware threads).\n--criterion <mrmr|jmi|cmim>\t "
+        "Selection criterion (default: mrmr).\n--sparse-threshold <ratio>\t Stores "
+        "features with at least this fraction of zeros sparse (default: 0.95).\n"
+        "--stats <file>\t Writes a JSON "
+        "report of timings and counters to <file> ('-' for stdout).\n--cache [file]\t "
+        "Reuses marginals and MI terms from a sidecar file (default: "
+        "<inputfile>.cache).\n--numa\t Spreads columns and worker threads over "
+        "the NUMA nodes.\n--mi-matrix <file>\t Writes the mutual information "
+        "between all pairs of features to <file> instead of selecting.\n--folds <k>\t "
+        "Selects on the training rows of each of k cross-validation folds.\n"
+        "--bootstraps <n>\t Selects on n bootstrap resamples of the rows.\n--seed "
+        "<seed>\t Seed of the bootstrap resamples (default: 0).\n--budget <ms>\t "
+        "Stops <ms> after start and prints the features decided so far; with --mi-matrix, "
+        "nothing is written.\n"
+        "--checkpoint <file>\t Saves the selection to <file> and resumes from it.\n"
+        "--checkpoint-interval <s>\t Seconds between checkpoint saves; it is also saved on "
+        "exit (default: 10, 0 saves after each feature).\n--stream\t Prints each feature "
+        "with its score and time as a line.\n--list-skipped\t Lists the constant and duplicate "
+        "features left out of the selection instead of counting them.\n-h Prints "
+        "this message");
+}
+
 options parseOptions(int argc, char *argv[])
 {
     options opts;
     opts.classIndex = 0;
     opts.selectedFeatures = 10;
     opts.file = "../data.mrmr";
+    opts.criterion = Criterion::MRMR;
+    opts.threads = defaultThreads();
+    opts.cache = false;
+    opts.folds = 0;
+    opts.bootstraps = 0;
+    opts.seed = 0;
+    opts.budgetMs = 0;
+    opts.checkpointIntervalS = 10;
+    opts.stream = false;
+    opts.listSkipped = false;
 
     if (argc > 1) {
         for (int i = 0; i < argc; ++i) {
@@ -68,13 +121,62 @@ options parseOptions(int argc, char *argv[])
             if (strcmp(argv[i], "-c") == 0) {
                 opts.classIndex = atoi(argv[i + 1]) - 1;
             }
+            if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+                opts.threads = atoi(argv[i + 1]);
+            }
+            if (strcmp(argv[i], "--criterion") == 0 && i + 1 < argc) {
+                try {
+                    opts.criterion = parseCriterion(argv[i + 1]);
+                } catch (const std::invalid_argument &e) {
+                    std::cerr << e.what() << std::endl;
+                    printUsage();
+                    exit(EXIT_FAILURE);
+                }
+            }
+            if (strcmp(argv[i], "--sparse-threshold") == 0 && i + 1 < argc) {
+                opts.load.sparse_threshold = atof(argv[i + 1]);
+            }
+            if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+                opts.statsFile = argv[i + 1];
+            }
+            if (strcmp(argv[i], "--mi-matrix") == 0 && i + 1 < argc) {
+                opts.matrixFile = argv[i + 1];
+            }
+            if (strcmp(argv[i], "--folds") == 0 && i + 1 < argc) {
+                opts.folds = atoi(argv[i + 1]);
+            }
+            if (strcmp(argv[i], "--bootstraps") == 0 && i + 1 < argc) {
+                opts.bootstraps = atoi(argv[i + 1]);
+            }
+            if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+                opts.seed = strtoull(argv[i + 1], nullptr, 10);
+            }
+            if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+                opts.budgetMs = atof(argv[i + 1]);
+            }
+            if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+                opts.checkpointFile = argv[i + 1];
+            }
+            if (strcmp(argv[i], "--checkpoint-interval") == 0 && i + 1 < argc) {
+                opts.checkpointIntervalS = atof(argv[i + 1]);
+            }
+            if (strcmp(argv[i], "--stream") == 0) {
+                opts.stream = true;
+            }
+            if (strcmp(argv[i], "--list-skipped") == 0) {
+                opts.listSkipped = true;
+            }
+            if (strcmp(argv[i], "--numa") == 0) {
+                opts.load.numa = true;
+            }
+            if (strcmp(argv[i], "--cache") == 0) {
+                opts.cache = true;
+                if (i + 1 < argc && argv[i + 1][0] != '-') {
+                    opts.cacheFile = argv[i + 1];
+                }
+            }
             if (strcmp(argv[i], "-h") == 0) {
-                printf(
-                    "fast-mrmr:\nOptions:\n -f <inputfile>\t\tMRMR file generated "
-                    "using mrmrReader (default: data.mrmr).\n-c "
-                    "<classindex>\t\tIndicates the class index in the dataset "
-                    "(default: 0).\n-a <nfeatures>\t Indicates the number of "
-                    "features to select (default: 10).\n-h Prints this message");
+                printUsage();
                 exit(0);
             }
         }
@@ -82,64 +184,184 @@ options parseOptions(int argc, char *argv[])
     return opts;
 }
 
+// Prints how many features the selection skips to stderr, or with list every one of them,
+// duplicates as feature:original.
+void reportRedundantFeatures(const RawData &rawData, bool list)
+{
+    const std::uint32_t constants = rawData.getConstantFeaturesSize();
+    const std::uint32_t duplicates = rawData.getDuplicateFeaturesSize();
+    if (!list) {
+        if (constants > 0 || duplicates > 0) {
+            std::cerr << "Skipped " << constants << " constant and " << duplicates
+                      << " duplicate features (--list-skipped lists them)" << std::endl;
+        }
+        return;
+    }
+
+    if (constants > 0) {
+        std::cerr << "Constant features: ";
+        bool first = true;
+        for (std::uint32_t i = 0; i < rawData.getFeaturesSize(); ++i) {
+            if (rawData.isConstant(i)) {
+                std::cerr << (first ? "" : ",") << i;
+                first = false;
+            }
+        }
+        std::cerr << std::endl;
+    }
+    if (duplicates > 0) {
+        std::cerr << "Duplicate features: ";
+        bool first = true;
+        for (std::uint32_t i = 0; i < rawData.getFeaturesSize(); ++i) {
+            if (!rawData.isConstant(i) && rawData.getAlias(i) != i) {
+                std::cerr << (first ? "" : ",") << i << ":" << rawData.getAlias(i);
+                first = false;
+            }
+        }
+        std::cerr << std::endl;
+    }
+}
+
+// Raised by SIGINT and SIGTERM so that the selection stops cleanly with what it has. A second
+// signal gets the default handling, which ends the process at once (during loading, say).
+std::atomic<bool> stopRequested{false};
+
+void requestStop(int signal)
+{
+    stopRequested.store(true);
+    std::signal(signal, SIG_DFL);
+}
+
 int main(int argc, char *argv[])
 {
+    auto process_start = std::chrono::steady_clock::now();
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
     options opts;
-    std::uint32_t i = 0;
-    std::uint32_t j = 0;
-    std::uint32_t newFeatureIndex = 0;
-    std::uint32_t lastFeatureIndex = 0;
-    double mrmr = 0;
-    double best_score = 0;
-    std::vector<double> relevances;
-    std::vector<double> redundances;
-    std::vector<int> selectedFeatures;
 
     opts = parseOptions(argc, argv);
-    RawData rawData(opts.file);
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+    if (opts.budgetMs > 0) {
+        deadline = process_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                       std::chrono::duration<double, std::milli>(opts.budgetMs));
+    }
+    opts.load.threads = opts.threads;
+    std::uint32_t numa_nodes = opts.load.numa ? ThreadPool::instance().enableNumaPlacement() : 1;
 
-    auto start_time = std::chrono::high_resolution_clock::now();
+    std::optional<ScopedPhase> phase;
+    phase.emplace("load");
+    RawData rawData(opts.file, opts.load);
 
-    ProbTable prob = ProbTable(rawData);
-    MutualInfo mutualInfo = MutualInfo(rawData, prob);
+    phase.reset();
+
+    auto start_time = std::chrono::high_resolution_clock::now();
 
-    // Get relevances between all features and class.
-    for (i = 0; i < rawData.getFeaturesSize(); ++i) {
-        relevances.push_back(mutualInfo.fetch(opts.classIndex, i));
-        redundances.push_back(0);
+    // Constant and duplicate features are never candidates; report them so none goes missing
+    if (opts.matrixFile.empty()) {
+        reportRedundantFeatures(rawData, opts.listSkipped);
     }
 
-    // Max relevance feature is added because no redundancy is possible.
-    newFeatureIndex = getMaxRelevance(relevances, opts.classIndex);
-    selectedFeatures.push_back(newFeatureIndex);
-    lastFeatureIndex = newFeatureIndex;
-
-    std::cout << newFeatureIndex << ",";
-    // MRMR
-    while (selectedFeatures.size() < rawData.getFeaturesSize() - 1  //-1 because class is discarded
-           and selectedFeatures.size() < opts.selectedFeatures) {
-        best_score = -std::numeric_limits<double>::infinity();
-        for (j = 0; j < rawData.getFeaturesSize(); ++j) {
-            // If feature not in selected selectedFeatures
-            if (find(selectedFeatures.begin(), selectedFeatures.end(), j) == selectedFeatures.end()
-                && j != opts.classIndex) {
-                redundances[j] += mutualInfo.fetch(lastFeatureIndex, j);
-                mrmr = relevances[j] - (redundances[j] / selectedFeatures.size());
-                if (mrmr > best_score) {
-                    best_score = mrmr;
-                    newFeatureIndex = j;
-                }
+    std::vector<SelectedFeature> selectedFeatures;
+    std::unique_ptr<Sidecar> sidecar;
+    if (!opts.matrixFile.empty()) {
+        MutualInfoMatrix matrix(rawData);
+        matrix.setStopFlag(&stopRequested);
+        matrix.setDeadline(deadline);
+        matrix.compute(opts.threads);
+        if (matrix.wasInterrupted()) {
+            std::cerr << "Matrix computation stopped, " << opts.matrixFile << " not written"
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+        matrix.write(opts.matrixFile);
+    } else if (opts.folds > 0 || opts.bootstraps > 0) {
+        SubsetSelector selector(rawData, opts.classIndex, opts.criterion);
+        selector.setThreads(opts.threads);
+        selector.setStopFlag(&stopRequested);
+        selector.setDeadline(deadline);
+        if (opts.folds > 0) {
+            for (const RowWeights &weights : makeFolds(rawData.getDataSize(), opts.folds)) {
+                selector.addSubset(weights);
             }
         }
-        // Last feature doesn't prints comma.
-        if ((selectedFeatures.size() == (opts.selectedFeatures - 1))
-            or (selectedFeatures.size() == (rawData.getFeaturesSize() - 2))) {
-            std::cout << newFeatureIndex;
-        } else {
-            std::cout << newFeatureIndex << ",";
+        if (opts.bootstraps > 0) {
+            for (const RowWeights &weights :
+                 makeBootstraps(rawData.getDataSize(), opts.bootstraps, opts.seed)) {
+                selector.addSubset(weights);
+            }
+        }
+
+        // One line per subset, then the features by how many subsets selected them
+        SubsetSelection selection = selector.select(opts.selectedFeatures);
+        for (std::size_t s = 0; s < selection.selections.size(); ++s) {
+            std::cout << "Subset " << s << ": ";
+            for (std::size_t k = 0; k < selection.selections[s].size(); ++k) {
+                std::cout << (k == 0 ? "" : ",") << selection.selections[s][k].index;
+            }
+            std::cout << std::endl;
+            selectedFeatures.insert(selectedFeatures.end(),
+                                    selection.selections[s].begin(),
+                                    selection.selections[s].end());
+        }
+        std::vector<std::uint32_t> order;
+        for (std::uint32_t j = 0; j < selection.frequencies.size(); ++j) {
+            if (selection.frequencies[j] > 0) {
+                order.push_back(j);
+            }
+        }
+        std::stable_sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b) {
+            return selection.frequencies[a] > selection.frequencies[b];
+        });
+        std::cout << "Frequencies: ";
+        for (std::size_t k = 0; k < order.size(); ++k) {
+            std::cout << (k == 0 ? "" : ",") << order[k] << ":" << selection.frequencies[order[k]];
+        }
+        std::cout << std::endl;
+        if (selector.wasInterrupted()) {
+            std::cerr << "Selection stopped early" << std::endl;
+            Stats::instance().setValue("interrupted", 1);
+        }
+    } else {
+        // Only the greedy selection reads marginals and cached terms
+        if (opts.cache) {
+            phase.emplace("cache/open");
+            sidecar = std::make_unique<Sidecar>(
+                opts.cacheFile.empty() ? opts.file + ".cache" : opts.cacheFile, rawData);
+        }
+        phase.emplace("marginals");
+        ProbTable prob = ProbTable(rawData);
+        MutualInfo mutualInfo = MutualInfo(rawData, prob);
+        mutualInfo.setCache(sidecar.get());
+        phase.reset();
+
+        FeatureSelector selector(rawData, mutualInfo, opts.classIndex, opts.criterion);
+        selector.setThreads(opts.threads);
+        selector.setStopFlag(&stopRequested);
+        selector.setDeadline(deadline);
+        if (!opts.checkpointFile.empty()) {
+            selector.setCheckpoint(
+                opts.checkpointFile,
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(opts.checkpointIntervalS)));
+        }
+
+        bool first = true;
+        selectedFeatures = selector.select(
+            opts.selectedFeatures, [&first, &opts](const SelectedFeature &feature) {
+                if (opts.stream) {
+                    std::cout << feature.index << "\t" << feature.score << "\t"
+                              << feature.elapsed_ms << std::endl;
+                    return;
+                }
+                // Last feature doesn't prints comma.
+                std::cout << (first ? "" : ",") << feature.index << std::flush;
+                first = false;
+            });
+        if (selector.wasInterrupted()) {
+            std::cerr << "Selection stopped after " << selectedFeatures.size() << " features"
+                      << std::endl;
+            Stats::instance().setValue("interrupted", 1);
         }
-        selectedFeatures.push_back(newFeatureIndex);
-        lastFeatureIndex = newFeatureIndex;
     }
 
     // Calculate elapsed time
@@ -148,5 +370,39 @@ int main(int argc, char *argv[])
 
     std::cout << "Elapsed time: " << elapsed_ms << " ms" << std::endl;
 
+    if (sidecar) {
+        phase.emplace("cache/save");
+        sidecar->save();
+        phase.reset();
+    }
+
+    if (!opts.statsFile.empty()) {
+        Stats &stats = Stats::instance();
+        stats.setValue("samples", rawData.getDataSize());
+        stats.setValue("features", rawData.getFeaturesSize());
+        stats.setValue("sparse_features", rawData.getSparseFeaturesSize());
+        stats.setValue("constant_features", rawData.getConstantFeaturesSize());
+        stats.setValue("duplicate_features", rawData.getDuplicateFeaturesSize());
+        stats.setValue("selected_features", selectedFeatures.size());
+        stats.setValue("threads", opts.threads);
+        stats.setValue("numa_nodes", numa_nodes);
+        stats.setValue("workspace_allocations", Workspace::allocations());
+        stats.setValue("workspace_reserved_bytes", Workspace::reservedBytes());
+        if (sidecar) {
+            stats.setValue("sidecar_entries", sidecar->size());
+        }
+
+        if (opts.statsFile == "-") {
+            stats.writeJson(std::cout);
+        } else {
+            std::ofstream stats_file(opts.statsFile);
+            if (!stats_file) {
+                std::cerr << "Could not open stats file: " << opts.statsFile << std::endl;
+                return EXIT_FAILURE;
+            }
+            stats.writeJson(stats_file);
+        }
+    }
+
     return EXIT_SUCCESS;
 }
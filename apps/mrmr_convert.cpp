@@ -0,0 +1,80 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include "ColumnFormat.h"
+#include "Parallel.h"
+#include "RawData.h"
+
+// Converts a .mrmr file (any version) to the block-compressed columnar version 2 format, or
+// back to row-major with the 64-bit version 1 header (-v 1) or the original one (-v 0).
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        std::cout << "Usage: " << argv[0]
+                  << " <inputfile> <outputfile> [-b <blockrows>] [-t <threads>] [-v <0|1|2>]\n";
+        return EXIT_FAILURE;
+    }
+
+    std::string inputFilename = argv[1];
+    std::string outputFilename = argv[2];
+    std::uint32_t blockRows = kDefaultBlockRows;
+    std::uint32_t version = kColumnarVersion;
+    LoadOptions load;
+    load.sparse_threshold = 2.0;
+
+    for (int i = 3; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "-b") == 0) {
+            blockRows = atoi(argv[i + 1]);
+        }
+        if (strcmp(argv[i], "-t") == 0) {
+            load.threads = atoi(argv[i + 1]);
+        }
+        if (strcmp(argv[i], "-v") == 0) {
+            version = atoi(argv[i + 1]);
+        }
+    }
+
+    try {
+        RawData rawData(inputFilename, load);
+        std::uint32_t threads = load.threads == 0 ? defaultThreads() : load.threads;
+        if (version == kColumnarVersion) {
+            writeColumnarFile(outputFilename, rawData, blockRows, threads);
+        } else if (version <= kRowMajorVersion) {
+            writeRowMajorFile(outputFilename, rawData, version == kRowMajorVersion);
+        } else {
+            throw std::invalid_argument("Unknown format version: " + std::to_string(version));
+        }
+
+        auto inputSize = std::filesystem::file_size(inputFilename);
+        auto outputSize = std::filesystem::file_size(outputFilename);
+        std::cout << "Converted " << rawData.getDataSize() << " samples and "
+                  << rawData.getFeaturesSize() << " features to " << outputFilename << " ("
+                  << inputSize << " -> " << outputSize << " bytes)" << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,373 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Python.h must come first, it may change the behaviour of the standard headers
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <future>
+#include <memory>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "FeatureSelector.h"
+#include "MutualInfo.h"
+#include "Parallel.h"
+#include "ProbTable.h"
+#include "RawData.h"
+
+namespace
+{
+// How often the waiting thread lets Python run its signal handlers during a selection.
+constexpr std::chrono::milliseconds kSignalPoll{50};
+
+// Thrown once a Python exception has been set, to unwind back to the module entry point.
+struct PythonError {
+};
+
+[[noreturn]] void raise(PyObject *type, const char *message)
+{
+    PyErr_SetString(type, message);
+    throw PythonError();
+}
+
+struct Decref {
+    void operator()(PyObject *object) const
+    {
+        Py_XDECREF(object);
+    }
+};
+
+// Owned reference; empty after a failed call, with the Python exception set.
+using Object = std::unique_ptr<PyObject, Decref>;
+
+Object check(PyObject *object)
+{
+    if (object == nullptr) {
+        throw PythonError();
+    }
+    return Object(object);
+}
+
+struct BufferRelease {
+    void operator()(Py_buffer *view) const
+    {
+        PyBuffer_Release(view);
+        delete view;
+    }
+};
+
+// Buffer protocol view of an object, which keeps the exported memory alive until released.
+using BufferView = std::unique_ptr<Py_buffer, BufferRelease>;
+
+BufferView getBuffer(PyObject *object, int flags)
+{
+    auto view = std::make_unique<Py_buffer>();
+    if (PyObject_GetBuffer(object, view.get(), flags) != 0) {
+        throw PythonError();
+    }
+    return BufferView(view.release());
+}
+
+std::uint64_t toUnsigned(PyObject *value)
+{
+    unsigned long long result = PyLong_AsUnsignedLongLong(value);
+    if (PyErr_Occurred() != nullptr) {
+        throw PythonError();
+    }
+    return result;
+}
+
+// Struct format of unsigned bytes, with or without a byte order prefix. No format means "B".
+bool isUnsignedByteFormat(const char *format)
+{
+    if (format == nullptr) {
+        return true;
+    }
+    if (*format != '\0' && std::strchr("@=<>!|", *format) != nullptr) {
+        ++format;
+    }
+    return std::strcmp(format, "B") == 0;
+}
+
+// Where the values of a dataset live, gathered while holding the GIL. Either one pointer per
+// feature to its contiguous values, or row-major samples that RawData transposes. The views
+// keep that memory alive until the selection is done, and must be released with the GIL held.
+struct Source {
+    std::vector<const std::uint8_t *> columns;
+    const std::uint8_t *rows = nullptr;
+    std::uint64_t data_size = 0;
+    std::uint32_t features_size = 0;
+    std::vector<BufferView> views;
+    std::vector<std::uint8_t> copy;
+};
+
+// pyarrow tables and record batches; anything else is taken as an array.
+bool isArrow(PyObject *data)
+{
+    return PyObject_HasAttrString(data, "num_columns") && PyObject_HasAttrString(data, "num_rows")
+           && PyObject_HasAttrString(data, "column");
+}
+
+/**
+ * Reads a samples x features array of unsigned bytes through the buffer protocol. Layouts
+ * where each feature is contiguous, such as Fortran order, are used in place; C-order arrays
+ * are transposed by RawData, and other layouts are first copied to C order.
+ */
+Source fromArray(PyObject *data)
+{
+    if (!PyObject_CheckBuffer(data)) {
+        raise(PyExc_TypeError, "Expected a NumPy array or a pyarrow table");
+    }
+    BufferView view = getBuffer(data, PyBUF_RECORDS_RO);
+    if (view->ndim != 2) {
+        raise(PyExc_ValueError, "Expected a 2-D array of samples x features");
+    }
+    if (view->itemsize != 1 || !isUnsignedByteFormat(view->format)) {
+        raise(PyExc_TypeError, "Expected an array of uint8 values");
+    }
+    if (static_cast<std::uint64_t>(view->shape[1]) > UINT32_MAX) {
+        raise(PyExc_ValueError, "Too many features: at most 2^32 - 1 are supported");
+    }
+
+    Source source;
+    source.data_size = static_cast<std::uint64_t>(view->shape[0]);
+    source.features_size = static_cast<std::uint32_t>(view->shape[1]);
+    const auto *base = static_cast<const std::uint8_t *>(view->buf);
+    if (view->shape[0] <= 1 || view->strides[0] == 1) {
+        for (Py_ssize_t i = 0; i < view->shape[1]; ++i) {
+            source.columns.push_back(base + i * view->strides[1]);
+        }
+    } else if (view->strides[1] == 1 && view->strides[0] == view->shape[1]) {
+        source.rows = base;
+    } else {
+        source.copy.resize(static_cast<std::size_t>(view->len));
+        if (PyBuffer_ToContiguous(source.copy.data(), view.get(), view->len, 'C') != 0) {
+            throw PythonError();
+        }
+        source.rows = source.copy.data();
+    }
+    source.views.push_back(std::move(view));
+    return source;
+}
+
+/**
+ * Reads a table of uint8 columns without nulls. Each column is used in place, sliced ones
+ * included, unless it is split in several chunks, which are then concatenated by pyarrow.
+ */
+Source fromArrow(PyObject *table)
+{
+    Source source;
+    source.data_size = toUnsigned(check(PyObject_GetAttrString(table, "num_rows")).get());
+    const std::uint64_t columns =
+        toUnsigned(check(PyObject_GetAttrString(table, "num_columns")).get());
+    if (columns > UINT32_MAX) {
+        raise(PyExc_ValueError, "Too many features: at most 2^32 - 1 are supported");
+    }
+    source.features_size = static_cast<std::uint32_t>(columns);
+
+    for (std::uint32_t i = 0; i < source.features_size; ++i) {
+        Object column = check(PyObject_CallMethod(table, "column", "I", i));
+        if (PyObject_HasAttrString(column.get(), "num_chunks")) {
+            const std::uint64_t chunks =
+                toUnsigned(check(PyObject_GetAttrString(column.get(), "num_chunks")).get());
+            PyObject *array = chunks == 1
+                                  ? PyObject_CallMethod(column.get(), "chunk", "i", 0)
+                                  : PyObject_CallMethod(column.get(), "combine_chunks", nullptr);
+            column = check(array);
+        }
+
+        Object type = check(PyObject_GetAttrString(column.get(), "type"));
+        Object type_string = check(PyObject_Str(type.get()));
+        const char *type_name = PyUnicode_AsUTF8(type_string.get());
+        if (type_name == nullptr) {
+            throw PythonError();
+        }
+        if (std::strcmp(type_name, "uint8") != 0) {
+            raise(PyExc_TypeError, "Arrow columns must hold uint8 values");
+        }
+        if (toUnsigned(check(PyObject_GetAttrString(column.get(), "null_count")).get()) != 0) {
+            raise(PyExc_ValueError, "Arrow columns must not hold nulls");
+        }
+
+        // buffers() is [validity, values]; slices share the buffer and start at offset
+        Object buffers = check(PyObject_CallMethod(column.get(), "buffers", nullptr));
+        Object values = check(PySequence_GetItem(buffers.get(), 1));
+        const std::uint8_t *base = nullptr;
+        if (values.get() != Py_None) {
+            BufferView view = getBuffer(values.get(), PyBUF_SIMPLE);
+            base = static_cast<const std::uint8_t *>(view->buf)
+                   + toUnsigned(check(PyObject_GetAttrString(column.get(), "offset")).get());
+            source.views.push_back(std::move(view));
+        } else if (source.data_size > 0) {
+            raise(PyExc_ValueError, "Arrow column without a values buffer");
+        }
+        source.columns.push_back(base);
+    }
+    return source;
+}
+
+/**
+ * Runs the greedy selection in-process on a NumPy array or pyarrow table. The class is one of
+ * the columns, as in .mrmr files.
+ *
+ * Loading and selecting run on a separate thread with the GIL released. The calling thread
+ * meanwhile lets Python handle signals every kSignalPoll; when a handler raises, as the
+ * default SIGINT handler does with KeyboardInterrupt, the selection is stopped through its
+ * stop flag and the exception is propagated.
+ */
+PyObject *selectFeatures(PyObject *data,
+                         std::uint32_t class_index,
+                         std::uint32_t count,
+                         const char *criterion,
+                         std::uint32_t threads,
+                         double sparse_threshold)
+{
+    Source source = isArrow(data) ? fromArrow(data) : fromArray(data);
+    Criterion parsed = parseCriterion(criterion);
+    LoadOptions options;
+    options.threads = threads;
+    options.sparse_threshold = sparse_threshold;
+
+    std::atomic<bool> stop{false};
+    std::vector<SelectedFeature> selected;
+    std::exception_ptr error;
+    bool signalled = false;
+
+    auto run = [&] {
+        std::unique_ptr<RawData> raw_data;
+        if (source.rows != nullptr) {
+            std::span<const std::uint8_t> rows(source.rows,
+                                               source.data_size * source.features_size);
+            raw_data = std::make_unique<RawData>(rows, source.features_size, options);
+        } else {
+            raw_data = std::make_unique<RawData>(source.columns, source.data_size, options);
+        }
+
+        ProbTable prob(*raw_data);
+        MutualInfo mutual_info(*raw_data, prob);
+        FeatureSelector selector(*raw_data, mutual_info, class_index, parsed);
+        selector.setThreads(threads == 0 ? defaultThreads() : threads);
+        selector.setStopFlag(&stop);
+        selected = selector.select(count);
+    };
+
+    Py_BEGIN_ALLOW_THREADS
+    std::future<void> done = std::async(std::launch::async, run);
+    while (done.wait_for(kSignalPoll) != std::future_status::ready) {
+        Py_BLOCK_THREADS
+        if (!signalled && PyErr_CheckSignals() != 0) {
+            signalled = true;
+            stop.store(true);
+        }
+        Py_UNBLOCK_THREADS
+    }
+    try {
+        done.get();
+    } catch (...) {
+        error = std::current_exception();
+    }
+    Py_END_ALLOW_THREADS
+
+    if (signalled) {
+        throw PythonError();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    Object indices = check(PyList_New(static_cast<Py_ssize_t>(selected.size())));
+    Object scores = check(PyList_New(static_cast<Py_ssize_t>(selected.size())));
+    for (std::size_t k = 0; k < selected.size(); ++k) {
+        PyList_SET_ITEM(indices.get(), static_cast<Py_ssize_t>(k),
+                        check(PyLong_FromUnsignedLong(selected[k].index)).release());
+        PyList_SET_ITEM(scores.get(), static_cast<Py_ssize_t>(k),
+                        check(PyFloat_FromDouble(selected[k].score)).release());
+    }
+    return check(PyTuple_Pack(2, indices.get(), scores.get())).release();
+}
+
+// Entry point of fast_mrmr.select: parses the arguments and maps C++ exceptions to Python ones.
+PyObject *select(PyObject *, PyObject *args, PyObject *kwargs)
+{
+    static const char *keywords[] = {
+        "data", "class_index", "count", "criterion", "threads", "sparse_threshold", nullptr};
+    PyObject *data = nullptr;
+    unsigned int class_index = 0;
+    unsigned int count = 10;
+    const char *criterion = "mrmr";
+    unsigned int threads = 0;
+    double sparse_threshold = 0.95;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|IIsId:select",
+                                     const_cast<char **>(keywords), &data, &class_index, &count,
+                                     &criterion, &threads, &sparse_threshold)) {
+        return nullptr;
+    }
+
+    try {
+        return selectFeatures(data, class_index, count, criterion, threads, sparse_threshold);
+    } catch (const PythonError &) {
+    } catch (const std::invalid_argument &e) {
+        PyErr_SetString(PyExc_ValueError, e.what());
+    } catch (const std::out_of_range &e) {
+        PyErr_SetString(PyExc_IndexError, e.what());
+    } catch (const std::bad_alloc &) {
+        PyErr_NoMemory();
+    } catch (const std::exception &e) {
+        PyErr_SetString(PyExc_RuntimeError, e.what());
+    }
+    return nullptr;
+}
+
+PyDoc_STRVAR(kSelectDoc,
+             "select(data, class_index=0, count=10, criterion=\"mrmr\", threads=0, "
+             "sparse_threshold=0.95)\n--\n\n"
+             "Selects up to count features of data, a samples x features uint8 NumPy array (or "
+             "any\nbuffer of unsigned bytes) or a pyarrow table of uint8 columns, one of which "
+             "(class_index)\nis the class. Column-major data is used without copying. Returns "
+             "the lists of selected\nfeature indices and of their scores, in selection order. "
+             "criterion is \"mrmr\", \"jmi\" or\n\"cmim\"; threads=0 uses all hardware threads. "
+             "Ctrl-C stops the selection with\nKeyboardInterrupt.");
+
+PyMethodDef kMethods[] = {
+    {"select", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(select)),
+     METH_VARARGS | METH_KEYWORDS, kSelectDoc},
+    {nullptr, nullptr, 0, nullptr}};
+
+PyModuleDef kModule = {PyModuleDef_HEAD_INIT,
+                       "fast_mrmr",
+                       "Feature selection by mutual information (mRMR, JMI, CMIM) with fast-mRMR",
+                       -1,
+                       kMethods,
+                       nullptr,
+                       nullptr,
+                       nullptr,
+                       nullptr};
+}  // namespace
+
+PyMODINIT_FUNC PyInit_fast_mrmr()
+{
+    return PyModule_Create(&kModule);
+}
@@ -0,0 +1,228 @@
+#
+# Licensed to the Apache Software Foundation (ASF) under one or more
+# contributor license agreements.  See the NOTICE file distributed with
+# this work for additional information regarding copyright ownership.
+# The ASF licenses this file to You under the Apache License, Version 2.0
+# (the "License"); you may not use this file except in compliance with
+# the License.  You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+"""Tests of the fast_mrmr module against fast-mrmr_cli.
+
+Needs NumPy and pyarrow, the built module on the Python path and the CLI in FAST_MRMR_CLI:
+
+    FAST_MRMR_CLI=build/linux/x86_64/release/fast-mrmr_cli \\
+        PYTHONPATH=build/linux/x86_64/release python3 -m unittest python/test_fast_mrmr.py
+"""
+
+import math
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+import textwrap
+import unittest
+
+import numpy as np
+import pyarrow as pa
+
+import fast_mrmr
+
+SAMPLES = 3000
+FEATURES = 40
+COUNT = 10
+
+
+def make_dataset(samples, features, seed=1):
+    """Values below 4, with the class in column 0 depending on a few of the features."""
+    generator = np.random.default_rng(seed)
+    data = generator.integers(0, 4, size=(samples, features), dtype=np.uint8)
+    noise = generator.integers(0, 8, size=samples) == 0
+    data[:, 0] = (data[:, 3] + data[:, 7] // 2 + (data[:, 12] > 1) + noise) % 4
+    return data
+
+
+def run_cli(data, count, criterion="mrmr"):
+    """Selects on data written as a .mrmr file and returns the indices and scores printed."""
+    with tempfile.TemporaryDirectory() as directory:
+        path = os.path.join(directory, "data.mrmr")
+        with open(path, "wb") as out:
+            out.write(struct.pack("<II", data.shape[0], data.shape[1]))
+            out.write(np.ascontiguousarray(data).tobytes())
+        output = subprocess.run([os.environ["FAST_MRMR_CLI"], "-f", path, "-c", "1",
+                                 "-a", str(count + 1), "--criterion", criterion, "--stream"],
+                                check=True, capture_output=True, text=True).stdout
+    fields = [line.split("\t") for line in output.splitlines() if line.count("\t") == 2]
+    return [int(field[0]) for field in fields], [float(field[1]) for field in fields]
+
+
+def run_script(source):
+    """Runs source in a fresh interpreter that imports the same fast_mrmr, returns stdout."""
+    environment = dict(os.environ)
+    environment["PYTHONPATH"] = os.pathsep.join(
+        [os.path.dirname(os.path.abspath(fast_mrmr.__file__))]
+        + environment.get("PYTHONPATH", "").split(os.pathsep))
+    return subprocess.run([sys.executable, "-c", textwrap.dedent(source)], env=environment,
+                          check=True, capture_output=True, text=True).stdout
+
+
+# Peak resident memory added by one selection over a 100 MB dataset in the given layout, as a
+# fraction of the dataset size. The data is filled in place so that the peak before the
+# selection is the dataset itself.
+MEMORY_SCRIPT = """
+    import resource
+    import numpy as np, pyarrow as pa
+    import fast_mrmr
+
+    samples, features = 200000, 500
+    layout = "{layout}"
+    generator = np.random.default_rng(0)
+    if layout == "c":
+        data = np.empty((samples, features), dtype=np.uint8)
+        for start in range(0, samples, 1000):
+            data[start:start + 1000] = generator.integers(0, 4, (1000, features), np.uint8)
+    else:
+        data = np.empty((features, samples), dtype=np.uint8)
+        for start in range(0, features, 10):
+            data[start:start + 10] = generator.integers(0, 4, (10, samples), np.uint8)
+        data = data.T
+    if layout == "arrow":
+        data = pa.table([pa.array(data[:, i]) for i in range(features)],
+                        names=[str(i) for i in range(features)])
+    before = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    fast_mrmr.select(data, count=2, threads=1)
+    after = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    print((after - before) * 1024 / (samples * features))
+"""
+
+# Sends SIGINT to itself while a long selection runs and prints how it ended.
+INTERRUPT_SCRIPT = """
+    import os, signal, threading, time
+    import numpy as np
+    import fast_mrmr
+
+    data = np.asfortranarray(np.random.default_rng(0).integers(0, 4, (50000, 1000), np.uint8))
+    threading.Timer(0.5, os.kill, (os.getpid(), signal.SIGINT)).start()
+    start = time.monotonic()
+    try:
+        fast_mrmr.select(data, count=999, threads=1)
+        print("finished", time.monotonic() - start)
+    except KeyboardInterrupt:
+        print("interrupted", time.monotonic() - start)
+"""
+
+
+class SelectTest(unittest.TestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        if "FAST_MRMR_CLI" not in os.environ:
+            raise unittest.SkipTest("FAST_MRMR_CLI is not set")
+        cls.data = make_dataset(SAMPLES, FEATURES)
+        cls.expected = run_cli(cls.data, COUNT)
+
+    def assertSelection(self, selection, expected):
+        indices, scores = selection
+        self.assertEqual(indices, expected[0])
+        self.assertEqual(len(scores), len(expected[1]))
+        for score, expected_score in zip(scores, expected[1]):
+            self.assertTrue(math.isclose(score, expected_score, rel_tol=1e-5, abs_tol=1e-6),
+                            "%r != %r" % (score, expected_score))
+
+    def test_c_order(self):
+        data = np.ascontiguousarray(self.data)
+        self.assertSelection(fast_mrmr.select(data, count=COUNT), self.expected)
+
+    def test_fortran_order(self):
+        data = np.asfortranarray(self.data)
+        self.assertSelection(fast_mrmr.select(data, count=COUNT), self.expected)
+
+    def test_strided(self):
+        wide = np.zeros((SAMPLES * 2, FEATURES * 3), dtype=np.uint8)
+        wide[::2, ::3] = self.data
+        self.assertSelection(fast_mrmr.select(wide[::2, ::3], count=COUNT), self.expected)
+
+    def test_criteria(self):
+        for criterion in ("jmi", "cmim"):
+            self.assertSelection(
+                fast_mrmr.select(self.data, count=COUNT, criterion=criterion),
+                run_cli(self.data, COUNT, criterion))
+
+    def test_threads(self):
+        self.assertSelection(fast_mrmr.select(self.data, count=COUNT, threads=1), self.expected)
+
+    def test_class_index(self):
+        shifted = np.roll(self.data, 5, axis=1)
+        indices, scores = fast_mrmr.select(shifted, class_index=5, count=COUNT)
+        self.assertEqual(indices, [(index + 5) % FEATURES for index in self.expected[0]])
+
+    def test_arrow_table(self):
+        table = pa.table([pa.array(self.data[:, i]) for i in range(FEATURES)],
+                         names=[str(i) for i in range(FEATURES)])
+        self.assertSelection(fast_mrmr.select(table, count=COUNT), self.expected)
+        self.assertSelection(fast_mrmr.select(table.to_batches()[0], count=COUNT),
+                             self.expected)
+
+    def test_arrow_sliced(self):
+        padded = np.concatenate([self.data[-7:], self.data, self.data[:5]])
+        table = pa.table([pa.array(padded[:, i]) for i in range(FEATURES)],
+                         names=[str(i) for i in range(FEATURES)])
+        sliced = table.slice(7, SAMPLES)
+        self.assertEqual(sliced.column(0).chunk(0).offset, 7)
+        self.assertSelection(fast_mrmr.select(sliced, count=COUNT), self.expected)
+
+    def test_arrow_chunked(self):
+        bounds = [0, 1, 1000, 1001, 2500, SAMPLES]
+        columns = [pa.chunked_array([self.data[start:end, i]
+                                     for start, end in zip(bounds, bounds[1:])])
+                   for i in range(FEATURES)]
+        table = pa.table(columns, names=[str(i) for i in range(FEATURES)])
+        self.assertEqual(table.column(0).num_chunks, len(bounds) - 1)
+        self.assertSelection(fast_mrmr.select(table, count=COUNT), self.expected)
+        self.assertSelection(fast_mrmr.select(table.slice(0, SAMPLES), count=COUNT),
+                             self.expected)
+
+    def test_rejects_other_types(self):
+        with self.assertRaises(TypeError):
+            fast_mrmr.select(self.data.astype(np.int64))
+        with self.assertRaises(TypeError):
+            fast_mrmr.select(self.data.astype(np.int8))
+        with self.assertRaises(TypeError):
+            fast_mrmr.select(pa.table({"a": pa.array([1, 2], pa.int32())}))
+        with self.assertRaises(ValueError):
+            fast_mrmr.select(pa.table({"a": pa.array([1, None], pa.uint8())}))
+        with self.assertRaises(ValueError):
+            fast_mrmr.select(self.data[:, 0])
+        with self.assertRaises(ValueError):
+            fast_mrmr.select(self.data, criterion="mifs")
+        with self.assertRaises(TypeError):
+            fast_mrmr.select([[1, 2], [3, 4]])
+
+    def test_uint8_with_byte_order(self):
+        data = self.data.view(np.dtype("<u1"))
+        self.assertSelection(fast_mrmr.select(data, count=COUNT), self.expected)
+
+    def test_no_copy(self):
+        copied = float(run_script(MEMORY_SCRIPT.format(layout="c")))
+        self.assertGreater(copied, 0.5, "the C-order control should copy the data")
+        for layout in ("fortran", "arrow"):
+            growth = float(run_script(MEMORY_SCRIPT.format(layout=layout)))
+            self.assertLess(growth, 0.1, "%s input was copied" % layout)
+
+    def test_interrupt(self):
+        outcome, elapsed = run_script(INTERRUPT_SCRIPT).split()
+        self.assertEqual(outcome, "interrupted")
+        self.assertLess(float(elapsed), 5.0)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,102 @@
+#
+# Licensed to the Apache Software Foundation (ASF) under one or more
+# contributor license agreements.  See the NOTICE file distributed with
+# this work for additional information regarding copyright ownership.
+# The ASF licenses this file to You under the Apache License, Version 2.0
+# (the "License"); you may not use this file except in compliance with
+# the License.  You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+"""Compares fast-mrmr_cli with and without --numa on a generated dataset.
+
+Writes a seeded random dataset in the .mrmr format, runs the selection several times per
+configuration and prints the median wall time of each phase taken from --stats. Besides the
+plain and --numa runs, --fake-nodes N adds a --numa run with FAST_MRMR_NUMA_NODES=N, which
+exercises the placement code paths on a single-node machine (without its memory benefit).
+
+    python3 scripts/bench_numa.py --cli build/linux/x86_64/release/fast-mrmr_cli
+"""
+
+import argparse
+import json
+import os
+import random
+import statistics
+import struct
+import subprocess
+import tempfile
+
+PHASES = ("load", "relevance", "selection")
+
+
+def write_dataset(path, samples, features, bins, seed):
+    """Writes samples x features values below bins in the original row-major .mrmr layout."""
+    generator = random.Random(seed)
+    mapping = bytes(value % bins for value in range(256))
+    block = max(1, (1 << 24) // features)
+    with open(path, "wb") as out:
+        out.write(struct.pack("<II", samples, features))
+        for start in range(0, samples, block):
+            rows = min(block, samples - start)
+            out.write(generator.randbytes(rows * features).translate(mapping))
+
+
+def run(cli, dataset, args, environment):
+    """Runs the CLI once and returns the wall time of each phase in milliseconds."""
+    with tempfile.NamedTemporaryFile(suffix=".json") as stats:
+        subprocess.run([cli, "-f", dataset, "--stats", stats.name] + args,
+                       env=environment, check=True, stdout=subprocess.DEVNULL,
+                       stderr=subprocess.DEVNULL)
+        with open(stats.name) as report_file:
+            report = json.load(report_file)
+    times = {phase["name"]: phase["wall_ms"] for phase in report["phases"]}
+    times["nodes"] = report["values"]["numa_nodes"]
+    return times
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--cli", required=True, help="path of fast-mrmr_cli")
+    parser.add_argument("--samples", type=int, default=200000)
+    parser.add_argument("--features", type=int, default=2000)
+    parser.add_argument("--bins", type=int, default=8)
+    parser.add_argument("--seed", type=int, default=0)
+    parser.add_argument("--select", type=int, default=20, help="features to select")
+    parser.add_argument("--threads", type=int, default=0, help="0 uses all hardware threads")
+    parser.add_argument("--repeat", type=int, default=5)
+    parser.add_argument("--fake-nodes", type=int, default=0)
+    options = parser.parse_args()
+
+    configurations = [("default", [], {}), ("--numa", ["--numa"], {})]
+    if options.fake_nodes > 0:
+        configurations.append(("--numa, %d fake nodes" % options.fake_nodes, ["--numa"],
+                               {"FAST_MRMR_NUMA_NODES": str(options.fake_nodes)}))
+
+    with tempfile.TemporaryDirectory() as directory:
+        dataset = os.path.join(directory, "bench.mrmr")
+        write_dataset(dataset, options.samples, options.features, options.bins, options.seed)
+        args = ["-a", str(options.select + 1)]
+        if options.threads > 0:
+            args += ["-t", str(options.threads)]
+
+        print("%-24s %5s %12s %12s %12s" % (("configuration", "nodes") + PHASES))
+        for name, extra, variables in configurations:
+            environment = dict(os.environ, **variables)
+            runs = [run(options.cli, dataset, args + extra, environment)
+                    for _ in range(options.repeat)]
+            medians = [statistics.median(times.get(phase, 0.0) for times in runs)
+                       for phase in PHASES]
+            print("%-24s %5d %12.1f %12.1f %12.1f"
+                  % ((name, runs[0]["nodes"]) + tuple(medians)))
+
+
+if __name__ == "__main__":
+    main()
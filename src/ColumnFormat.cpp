@@ -0,0 +1,514 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ColumnFormat.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "Parallel.h"
+#include "RawData.h"
+#include "Transpose.h"
+#include "Workspace.h"
+
+namespace
+{
+constexpr char kMagic[4] = {'M', 'R', 'M', 'R'};
+constexpr std::size_t kFixedHeaderSize = 24;
+constexpr std::size_t kLegacyHeaderSize = 8;
+constexpr std::size_t kRowMajorHeaderSize = 24;
+constexpr std::size_t kBlockInfoSize = 16;
+// Raw feature bytes encoded per batch when writing, bounding the memory held by encoded blocks.
+constexpr std::size_t kWriteBatchBytes = std::size_t{256} << 20;
+// Bytes of samples gathered per block when writing row-major files.
+constexpr std::size_t kRowBlockBytes = std::size_t{16} << 20;
+
+template <typename T>
+void put(std::vector<std::uint8_t> &out, T value)
+{
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+        out.push_back(static_cast<std::uint8_t>(static_cast<std::uint64_t>(value) >> (8 * i)));
+    }
+}
+
+template <typename T>
+T get(const std::uint8_t *in)
+{
+    std::uint64_t value = 0;
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+        value |= static_cast<std::uint64_t>(in[i]) << (8 * i);
+    }
+    return static_cast<T>(value);
+}
+
+// Bits per value for the bit-packed codec, or 0 if the range does not fit in 4 bits.
+std::uint32_t packedBits(std::uint32_t values_range)
+{
+    if (values_range <= 2) {
+        return 1;
+    }
+    if (values_range <= 4) {
+        return 2;
+    }
+    if (values_range <= 16) {
+        return 4;
+    }
+    return 0;
+}
+
+std::size_t runLengthSize(const std::uint8_t *values, std::size_t count)
+{
+    std::size_t size = 0;
+    for (std::size_t i = 0; i < count;) {
+        std::size_t run = 1;
+        while (i + run < count && values[i + run] == values[i]) {
+            run++;
+        }
+        size += 1;
+        for (std::size_t r = run; r >= 0x80; r >>= 7) {
+            size++;
+        }
+        size += 1;
+        i += run;
+    }
+    return size;
+}
+}  // namespace
+
+std::uint64_t ColumnarHeader::blocksPerFeature() const
+{
+    return block_rows == 0 ? 0 : data_size / block_rows + (data_size % block_rows != 0);
+}
+
+std::uint64_t ColumnarHeader::headerSize() const
+{
+    return kFixedHeaderSize + 2ull * features_size
+           + kBlockInfoSize * features_size * blocksPerFeature();
+}
+
+const BlockInfo &ColumnarHeader::block(std::uint32_t feature, std::uint64_t block) const
+{
+    return blocks[feature * blocksPerFeature() + block];
+}
+
+/**
+ * Reads the header of a row-major file, either the original 32-bit one or version 1, leaving
+ * the stream at the first sample.
+ */
+RowMajorHeader readRowMajorHeader(std::istream &in)
+{
+    std::uint8_t buffer[kRowMajorHeaderSize] = {};
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char *>(buffer), kLegacyHeaderSize)) {
+        throw std::runtime_error("Failed to read data dimensions from file");
+    }
+
+    RowMajorHeader header;
+    if (std::memcmp(buffer, kMagic, sizeof(kMagic)) == 0
+        && get<std::uint16_t>(buffer + 4) == kRowMajorVersion
+        && get<std::uint16_t>(buffer + 6) == 0) {
+        if (!in.read(reinterpret_cast<char *>(buffer + kLegacyHeaderSize),
+                     kRowMajorHeaderSize - kLegacyHeaderSize)) {
+            throw std::runtime_error("Failed to read data dimensions from file");
+        }
+        header.data_size = get<std::uint64_t>(buffer + 8);
+        header.features_size = get<std::uint32_t>(buffer + 16);
+        header.data_offset = kRowMajorHeaderSize;
+    } else {
+        header.data_size = get<std::uint32_t>(buffer);
+        header.features_size = get<std::uint32_t>(buffer + 4);
+        header.data_offset = kLegacyHeaderSize;
+    }
+    return header;
+}
+
+/**
+ * Writes the features of rd as a row-major file. Samples are gathered a block at a time from
+ * the columns and transposed back into rows.
+ *
+ * @param filename Output path
+ * @param rd Loaded data to write
+ * @param wide Writes the version 1 header instead of the original 32-bit one
+ */
+void writeRowMajorFile(const std::string &filename, const RawData &rd, bool wide)
+{
+    const std::uint64_t data_size = rd.getDataSize();
+    const std::uint32_t features_size = rd.getFeaturesSize();
+    if (!wide && data_size > UINT32_MAX) {
+        throw std::invalid_argument("Too many samples for the 32-bit header");
+    }
+
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("Could not open file: " + filename);
+    }
+
+    std::vector<std::uint8_t> bytes;
+    if (wide) {
+        bytes.assign(kMagic, kMagic + sizeof(kMagic));
+        put<std::uint16_t>(bytes, kRowMajorVersion);
+        put<std::uint16_t>(bytes, 0);
+        put<std::uint64_t>(bytes, data_size);
+        put<std::uint32_t>(bytes, features_size);
+        put<std::uint32_t>(bytes, 0);
+    } else {
+        put<std::uint32_t>(bytes, data_size);
+        put<std::uint32_t>(bytes, features_size);
+    }
+    out.write(reinterpret_cast<const char *>(bytes.data()),
+              static_cast<std::streamsize>(bytes.size()));
+
+    if (features_size > 0 && data_size > 0) {
+        const std::size_t block_rows =
+            std::max<std::size_t>(1, kRowBlockBytes / features_size);
+        std::vector<std::uint8_t> columns(std::min<std::uint64_t>(block_rows, data_size)
+                                          * features_size);
+        std::vector<std::uint8_t> rows(columns.size());
+
+        for (std::uint64_t row = 0; row < data_size; row += block_rows) {
+            const std::size_t count = std::min<std::uint64_t>(block_rows, data_size - row);
+
+            // Feature-major slices of this block, sparse features expanded
+            for (std::uint32_t i = 0; i < features_size; ++i) {
+                std::uint8_t *slice = columns.data() + static_cast<std::size_t>(i) * count;
+                const std::uint8_t *column = rd.getColumn(i);
+                if (column != nullptr) {
+                    std::memcpy(slice, column + row, count);
+                    continue;
+                }
+                std::memset(slice, 0, count);
+                const SparseColumn &sparse = rd.getSparseColumn(i);
+                auto it = std::lower_bound(sparse.rows.begin(), sparse.rows.end(), row);
+                for (std::size_t k = it - sparse.rows.begin();
+                     k < sparse.rows.size() && sparse.rows[k] < row + count;
+                     ++k) {
+                    slice[sparse.rows[k] - row] = sparse.values[k];
+                }
+            }
+
+            transposeBlock(columns.data(), features_size, count, 0, count, rows.data(),
+                           features_size);
+            out.write(reinterpret_cast<const char *>(rows.data()),
+                      static_cast<std::streamsize>(count * features_size));
+        }
+    }
+
+    if (!out) {
+        throw std::runtime_error("Failed to write file: " + filename);
+    }
+}
+
+/**
+ * Checks whether the stream holds a version 2 file. The stream is rewound afterwards.
+ */
+bool isColumnarFile(std::istream &in)
+{
+    std::uint8_t buffer[6] = {};
+    in.seekg(0);
+    bool columnar = static_cast<bool>(in.read(reinterpret_cast<char *>(buffer), sizeof(buffer)))
+                    && std::memcmp(buffer, kMagic, sizeof(kMagic)) == 0
+                    && get<std::uint16_t>(buffer + 4) == kColumnarVersion;
+    in.clear();
+    in.seekg(0);
+    return columnar;
+}
+
+/**
+ * Reads the header and the block index, leaving the stream at the start of the payload. The
+ * sizes in the header are checked against the length of the stream before anything is
+ * allocated, so a corrupt or truncated file fails with std::runtime_error.
+ */
+ColumnarHeader readColumnarHeader(std::istream &in)
+{
+    in.seekg(0, std::ios::end);
+    const auto end = in.tellg();
+    if (end < 0) {
+        throw std::runtime_error("Failed to read columnar header from file");
+    }
+    const std::uint64_t length = static_cast<std::uint64_t>(end);
+
+    std::uint8_t fixed[kFixedHeaderSize];
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char *>(fixed), sizeof(fixed))
+        || std::memcmp(fixed, kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error("Failed to read columnar header from file");
+    }
+    if (get<std::uint16_t>(fixed + 4) != kColumnarVersion) {
+        throw std::runtime_error("Unsupported .mrmr version");
+    }
+
+    ColumnarHeader header;
+    header.data_size = get<std::uint64_t>(fixed + 8);
+    header.features_size = get<std::uint32_t>(fixed + 16);
+    header.block_rows = get<std::uint32_t>(fixed + 20);
+    if (header.block_rows == 0 && header.data_size > 0) {
+        throw std::runtime_error("Invalid block size in columnar header");
+    }
+    // Each feature needs its value range and one index entry per block
+    const std::uint64_t available = length - kFixedHeaderSize;
+    if (header.features_size > 0
+        && header.blocksPerFeature() > available / header.features_size / kBlockInfoSize) {
+        throw std::runtime_error("Columnar header is larger than the file");
+    }
+    if (header.headerSize() > length) {
+        throw std::runtime_error("Columnar header is larger than the file");
+    }
+    const std::uint64_t payload_size = length - header.headerSize();
+
+    std::vector<std::uint8_t> rest(header.headerSize() - kFixedHeaderSize);
+    if (!in.read(reinterpret_cast<char *>(rest.data()),
+                 static_cast<std::streamsize>(rest.size()))) {
+        throw std::runtime_error("Failed to read block index from file");
+    }
+
+    const std::uint8_t *cursor = rest.data();
+    header.values_range.resize(header.features_size);
+    for (std::uint16_t &range : header.values_range) {
+        range = get<std::uint16_t>(cursor);
+        cursor += 2;
+        if (range == 0 || range > 256) {
+            throw std::runtime_error("Invalid value range in columnar header");
+        }
+    }
+
+    header.blocks.resize(header.features_size * header.blocksPerFeature());
+    for (BlockInfo &block : header.blocks) {
+        block.offset = get<std::uint64_t>(cursor);
+        block.size = get<std::uint32_t>(cursor + 8);
+        block.codec = static_cast<BlockCodec>(cursor[12]);
+        cursor += kBlockInfoSize;
+        if (block.offset > payload_size || block.size > payload_size - block.offset) {
+            throw std::runtime_error("Block outside the payload in columnar header");
+        }
+    }
+
+    return header;
+}
+
+void writeColumnarHeader(std::ostream &out, const ColumnarHeader &header)
+{
+    std::vector<std::uint8_t> bytes;
+    bytes.reserve(header.headerSize());
+    bytes.insert(bytes.end(), kMagic, kMagic + sizeof(kMagic));
+    put<std::uint16_t>(bytes, kColumnarVersion);
+    put<std::uint16_t>(bytes, 0);
+    put<std::uint64_t>(bytes, header.data_size);
+    put<std::uint32_t>(bytes, header.features_size);
+    put<std::uint32_t>(bytes, header.block_rows);
+    for (std::uint16_t range : header.values_range) {
+        put<std::uint16_t>(bytes, range);
+    }
+    for (const BlockInfo &block : header.blocks) {
+        put<std::uint64_t>(bytes, block.offset);
+        put<std::uint32_t>(bytes, block.size);
+        put<std::uint8_t>(bytes, static_cast<std::uint8_t>(block.codec));
+        put<std::uint8_t>(bytes, 0);
+        put<std::uint16_t>(bytes, 0);
+    }
+    out.write(reinterpret_cast<const char *>(bytes.data()),
+              static_cast<std::streamsize>(bytes.size()));
+}
+
+/**
+ * Encodes a block of values with whichever codec gives the smallest output.
+ *
+ * @param values Values of the block
+ * @param count Number of values
+ * @param values_range Value range of the whole feature
+ * @param codec Set to the codec that was chosen
+ * @return The encoded bytes
+ */
+std::vector<std::uint8_t> encodeBlock(const std::uint8_t *values,
+                                      std::size_t count,
+                                      std::uint32_t values_range,
+                                      BlockCodec &codec)
+{
+    std::uint32_t bits = packedBits(values_range);
+    std::size_t packed_size = bits == 0 ? count + 1 : (count * bits + 7) / 8;
+    std::size_t run_length_size = runLengthSize(values, count);
+
+    std::vector<std::uint8_t> out;
+    if (run_length_size <= packed_size && run_length_size < count) {
+        codec = BlockCodec::RunLength;
+        out.reserve(run_length_size);
+        for (std::size_t i = 0; i < count;) {
+            std::size_t run = 1;
+            while (i + run < count && values[i + run] == values[i]) {
+                run++;
+            }
+            out.push_back(values[i]);
+            std::size_t remaining = run;
+            while (remaining >= 0x80) {
+                out.push_back(static_cast<std::uint8_t>(remaining | 0x80));
+                remaining >>= 7;
+            }
+            out.push_back(static_cast<std::uint8_t>(remaining));
+            i += run;
+        }
+    } else if (packed_size < count) {
+        codec = BlockCodec::BitPacked;
+        out.assign(packed_size, 0);
+        for (std::size_t i = 0; i < count; ++i) {
+            std::size_t bit = i * bits;
+            out[bit / 8] |= static_cast<std::uint8_t>(values[i] << (bit % 8));
+        }
+    } else {
+        codec = BlockCodec::Raw;
+        out.assign(values, values + count);
+    }
+    return out;
+}
+
+/**
+ * Decodes a block written by encodeBlock into exactly count values.
+ */
+void decodeBlock(BlockCodec codec,
+                 const std::uint8_t *src,
+                 std::size_t size,
+                 std::uint32_t values_range,
+                 std::uint8_t *dst,
+                 std::size_t count)
+{
+    switch (codec) {
+        case BlockCodec::Raw:
+            if (size != count) {
+                throw std::runtime_error("Corrupt raw block in columnar file");
+            }
+            std::memcpy(dst, src, count);
+            return;
+
+        case BlockCodec::RunLength: {
+            std::size_t written = 0;
+            std::size_t read = 0;
+            while (read < size) {
+                std::uint8_t value = src[read++];
+                std::size_t run = 0;
+                std::size_t shift = 0;
+                while (read < size && (src[read] & 0x80) && shift < 56) {
+                    run |= static_cast<std::size_t>(src[read++] & 0x7F) << shift;
+                    shift += 7;
+                }
+                if (read >= size) {
+                    throw std::runtime_error("Corrupt run-length block in columnar file");
+                }
+                run |= static_cast<std::size_t>(src[read++]) << shift;
+                if (run > count - written) {
+                    throw std::runtime_error("Corrupt run-length block in columnar file");
+                }
+                std::memset(dst + written, value, run);
+                written += run;
+            }
+            if (written != count) {
+                throw std::runtime_error("Corrupt run-length block in columnar file");
+            }
+            return;
+        }
+
+        case BlockCodec::BitPacked: {
+            std::uint32_t bits = packedBits(values_range);
+            if (bits == 0 || size != (count * bits + 7) / 8) {
+                throw std::runtime_error("Corrupt bit-packed block in columnar file");
+            }
+            const std::uint8_t mask = static_cast<std::uint8_t>((1u << bits) - 1);
+            for (std::size_t i = 0; i < count; ++i) {
+                std::size_t bit = i * bits;
+                dst[i] = (src[bit / 8] >> (bit % 8)) & mask;
+            }
+            return;
+        }
+    }
+    throw std::runtime_error("Unknown block codec in columnar file");
+}
+
+/**
+ * Writes the features of rd as a version 2 file. Features are encoded in parallel, a batch
+ * at a time, and the block index is written last once every offset is known.
+ *
+ * @param filename Output path
+ * @param rd Loaded data to write
+ * @param block_rows Number of values per compressed block
+ * @param threads Number of encoding threads
+ */
+void writeColumnarFile(const std::string &filename,
+                       const RawData &rd,
+                       std::uint32_t block_rows,
+                       std::uint32_t threads)
+{
+    if (block_rows == 0) {
+        throw std::invalid_argument("Block size must be positive");
+    }
+
+    ColumnarHeader header;
+    header.data_size = rd.getDataSize();
+    header.features_size = rd.getFeaturesSize();
+    header.block_rows = block_rows;
+    for (std::uint32_t range : rd.getValuesRangeArray()) {
+        header.values_range.push_back(static_cast<std::uint16_t>(range));
+    }
+    header.blocks.resize(header.features_size * header.blocksPerFeature());
+
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("Could not open file: " + filename);
+    }
+    // Placeholder, rewritten with the final offsets at the end
+    writeColumnarHeader(out, header);
+
+    const std::uint64_t blocks_per_feature = header.blocksPerFeature();
+    const std::size_t batch_features = std::max<std::size_t>(
+        1, kWriteBatchBytes / std::max<std::uint64_t>(header.data_size, 1));
+    std::uint64_t offset = 0;
+
+    for (std::uint32_t first = 0; first < header.features_size; first += batch_features) {
+        std::uint32_t last = static_cast<std::uint32_t>(
+            std::min<std::size_t>(first + batch_features, header.features_size));
+        std::vector<std::vector<std::vector<std::uint8_t>>> encoded(last - first);
+
+        parallelFor(last - first, threads, [&](std::size_t k) {
+            std::uint32_t feature = first + static_cast<std::uint32_t>(k);
+            const std::uint8_t *values =
+                rd.fetchFeature(feature, Workspace::local(), Workspace::Column::First);
+            encoded[k].resize(blocks_per_feature);
+            for (std::uint64_t b = 0; b < blocks_per_feature; ++b) {
+                std::uint64_t begin = b * block_rows;
+                std::uint64_t count = std::min<std::uint64_t>(block_rows, header.data_size - begin);
+                BlockInfo &info = header.blocks[feature * blocks_per_feature + b];
+                encoded[k][b] = encodeBlock(values + begin, count, header.values_range[feature],
+                                            info.codec);
+                info.size = static_cast<std::uint32_t>(encoded[k][b].size());
+            }
+        });
+
+        for (std::uint32_t feature = first; feature < last; ++feature) {
+            for (std::uint64_t b = 0; b < blocks_per_feature; ++b) {
+                const std::vector<std::uint8_t> &bytes = encoded[feature - first][b];
+                header.blocks[feature * blocks_per_feature + b].offset = offset;
+                out.write(reinterpret_cast<const char *>(bytes.data()),
+                          static_cast<std::streamsize>(bytes.size()));
+                offset += bytes.size();
+            }
+        }
+    }
+
+    out.seekp(0);
+    writeColumnarHeader(out, header);
+    if (!out) {
+        throw std::runtime_error("Failed to write file: " + filename);
+    }
+}
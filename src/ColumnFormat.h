@@ -0,0 +1,116 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class RawData;
+
+/*
+ * Row-major .mrmr files store one byte per value, sample after sample. The original header is
+ * two uint32 (data_size, features_size), which limits a file to 2^32 - 1 samples; version 1
+ * widens it (little-endian):
+ *
+ *   char     magic[4] = "MRMR"
+ *   uint16   version = 1
+ *   uint16   reserved = 0
+ *   uint64   data_size
+ *   uint32   features_size
+ *   uint32   reserved = 0
+ *   uint8    values[data_size][features_size]
+ */
+
+constexpr std::uint16_t kRowMajorVersion = 1;
+
+struct RowMajorHeader {
+    std::uint64_t data_size = 0;
+    std::uint32_t features_size = 0;
+    // Offset of the first sample from the start of the file.
+    std::uint64_t data_offset = 0;
+};
+
+RowMajorHeader readRowMajorHeader(std::istream &in);
+void writeRowMajorFile(const std::string &filename, const RawData &rd, bool wide);
+
+/*
+ * Version 2 of the .mrmr format stores each feature as a sequence of independently compressed
+ * blocks of block_rows values. All integers are little-endian.
+ *
+ *   char     magic[4] = "MRMR"
+ *   uint16   version = 2
+ *   uint16   reserved = 0
+ *   uint64   data_size
+ *   uint32   features_size
+ *   uint32   block_rows
+ *   uint16   values_range[features_size]
+ *   block    index[features_size * blocks_per_feature], feature-major:
+ *              uint64 offset (from the start of the payload), uint32 size,
+ *              uint8 codec, uint8 reserved[3]
+ *   payload
+ */
+
+constexpr std::uint16_t kColumnarVersion = 2;
+constexpr std::uint32_t kDefaultBlockRows = 1u << 20;
+
+enum class BlockCodec : std::uint8_t {
+    Raw = 0,
+    RunLength = 1,  // (value, LEB128 run length) pairs
+    BitPacked = 2   // 1, 2 or 4 bits per value depending on the value range
+};
+
+struct BlockInfo {
+    std::uint64_t offset;
+    std::uint32_t size;
+    BlockCodec codec;
+};
+
+struct ColumnarHeader {
+    std::uint64_t data_size = 0;
+    std::uint32_t features_size = 0;
+    std::uint32_t block_rows = kDefaultBlockRows;
+    std::vector<std::uint16_t> values_range;
+    std::vector<BlockInfo> blocks;
+
+    std::uint64_t blocksPerFeature() const;
+    std::uint64_t headerSize() const;
+    const BlockInfo &block(std::uint32_t feature, std::uint64_t block) const;
+};
+
+bool isColumnarFile(std::istream &in);
+ColumnarHeader readColumnarHeader(std::istream &in);
+void writeColumnarHeader(std::ostream &out, const ColumnarHeader &header);
+
+std::vector<std::uint8_t> encodeBlock(const std::uint8_t *values,
+                                      std::size_t count,
+                                      std::uint32_t values_range,
+                                      BlockCodec &codec);
+void decodeBlock(BlockCodec codec,
+                 const std::uint8_t *src,
+                 std::size_t size,
+                 std::uint32_t values_range,
+                 std::uint8_t *dst,
+                 std::size_t count);
+
+void writeColumnarFile(const std::string &filename,
+                       const RawData &rd,
+                       std::uint32_t block_rows,
+                       std::uint32_t threads);
@@ -0,0 +1,480 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FeatureSelector.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+
+#include "Parallel.h"
+#include "Stats.h"
+
+namespace
+{
+constexpr char kCheckpointMagic[4] = {'M', 'R', 'C', 'K'};
+constexpr std::uint32_t kCheckpointVersion = 1;
+
+// Checkpoints store native structs, like the sidecar: they are only meant to be read back on
+// the machine that wrote them, and anything that does not match is ignored.
+struct CheckpointHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint64_t content_hash;
+    std::uint32_t features_size;
+    std::uint32_t class_index;
+    std::uint32_t criterion;
+    std::uint32_t selected_size;
+};
+
+struct CheckpointEntry {
+    std::uint32_t index;
+    std::uint32_t reserved;
+    double score;
+    double elapsed_ms;
+};
+}  // namespace
+
+Criterion parseCriterion(const std::string &name)
+{
+    if (name == "mrmr") {
+        return Criterion::MRMR;
+    }
+    if (name == "jmi") {
+        return Criterion::JMI;
+    }
+    if (name == "cmim") {
+        return Criterion::CMIM;
+    }
+    throw std::invalid_argument("Unknown criterion: " + name);
+}
+
+std::string criterionName(Criterion criterion)
+{
+    switch (criterion) {
+        case Criterion::MRMR:
+            return "mrmr";
+        case Criterion::JMI:
+            return "jmi";
+        case Criterion::CMIM:
+            return "cmim";
+    }
+    return "unknown";
+}
+
+/**
+ * Features worth scoring against class_index: every feature but the class, except constant
+ * features, which carry no information, and features identical to an earlier candidate, which
+ * can never add anything to it.
+ */
+std::vector<bool> candidateFeatures(const RawData &rd, std::uint32_t class_index)
+{
+    const std::uint32_t features_size = rd.getFeaturesSize();
+    std::vector<bool> candidates(features_size, false);
+    // Whether a candidate with the values of each alias has been kept already
+    std::vector<bool> kept(features_size, false);
+    for (std::uint32_t i = 0; i < features_size; ++i) {
+        std::uint32_t alias = rd.getAlias(i);
+        if (i == class_index || rd.isConstant(i) || kept[alias]) {
+            continue;
+        }
+        candidates[i] = true;
+        kept[alias] = true;
+    }
+    return candidates;
+}
+
+FeatureSelector::FeatureSelector(RawData &rd,
+                                 MutualInfo &mi,
+                                 std::uint32_t class_index,
+                                 Criterion criterion)
+    : raw_data_(rd),
+      mutual_info_(mi),
+      class_index_(class_index),
+      criterion_(criterion),
+      threads_(defaultThreads()),
+      stop_(nullptr),
+      checkpoint_interval_(Clock::duration::zero()),
+      checkpoint_size_(0),
+      interrupted_(false),
+      candidates_size_(0)
+{
+    if (class_index_ >= raw_data_.getFeaturesSize()) {
+        throw std::out_of_range("Class index out of range");
+    }
+}
+
+// Number of threads candidates are scored on. Each one borrows its own Workspace.
+void FeatureSelector::setThreads(std::uint32_t threads)
+{
+    threads_ = std::max<std::uint32_t>(threads, 1);
+}
+
+// Stops the selection once the deadline passes; a step in progress is abandoned.
+void FeatureSelector::setDeadline(std::optional<Clock::time_point> deadline)
+{
+    deadline_ = deadline;
+}
+
+// Stops the selection as soon as *stop becomes true. Setting it from a signal handler is safe.
+void FeatureSelector::setStopFlag(const std::atomic<bool> *stop)
+{
+    stop_ = stop;
+}
+
+// Saves the selection state to path and resumes from it when it matches. The state is saved
+// after a decided feature once interval has passed since the last save, and when select()
+// returns; a zero interval saves after every feature.
+void FeatureSelector::setCheckpoint(std::string path, Clock::duration interval)
+{
+    checkpoint_path_ = std::move(path);
+    checkpoint_interval_ = interval;
+}
+
+// Whether the last select() stopped early because of the deadline or the stop flag.
+bool FeatureSelector::wasInterrupted() const
+{
+    return interrupted_.load();
+}
+
+/**
+ * Runs the greedy forward selection until count features are selected or no candidates
+ * remain. The first feature is always the most relevant one. When the deadline passes or the
+ * stop flag is raised, the step in progress is dropped and the features decided so far are
+ * returned.
+ *
+ * @param count Number of features to select
+ * @param on_select Invoked as soon as each feature is decided, and for every feature restored
+ *                  from a checkpoint
+ * @return The selected features in selection order, with the score they were selected with
+ */
+std::vector<SelectedFeature> FeatureSelector::select(std::uint32_t count, const Callback &on_select)
+{
+    std::uint32_t features_size = raw_data_.getFeaturesSize();
+    std::vector<SelectedFeature> result;
+
+    start_ = Clock::now();
+    interrupted_ = false;
+    selected_.clear();
+    selected_mask_.assign(features_size, false);
+    accumulated_.assign(features_size, 0.0);
+    terms_.assign(features_size, 0.0);
+    scores_.assign(features_size, 0.0);
+    evaluated_.assign(features_size, 0);
+    candidates_ = candidateFeatures(raw_data_, class_index_);
+    candidates_size_ = static_cast<std::uint32_t>(
+        std::count(candidates_.begin(), candidates_.end(), true));
+
+    std::optional<ScopedPhase> phase;
+    bool resumed = loadCheckpoint(result);
+    checkpoint_time_ = start_;
+    checkpoint_size_ = result.size();
+    if (resumed) {
+        // A checkpoint of a longer run only contributes its first count features
+        if (result.size() > count) {
+            result.resize(count);
+            selected_.resize(count);
+            selected_mask_.assign(features_size, false);
+            for (std::uint32_t index : selected_) {
+                selected_mask_[index] = true;
+            }
+        }
+        for (const SelectedFeature &feature : result) {
+            if (on_select) {
+                on_select(feature);
+            }
+        }
+    } else {
+        phase.emplace("relevance");
+        computeRelevances();
+        partial_scores_ = relevances_;
+        if (interrupted_) {
+            return result;
+        }
+    }
+
+    if (candidates_size_ == 0) {
+        return result;
+    }
+
+    phase.emplace("selection");
+    if (!resumed) {
+        record(selectFirst(), result, on_select);
+    }
+
+    while (selected_.size() < candidates_size_ && selected_.size() < count) {
+        if (shouldStop()) {
+            break;
+        }
+
+        auto step_start = Clock::now();
+        SelectedFeature feature =
+            criterion_ == Criterion::CMIM ? stepCmim() : stepAccumulated(result.back().index);
+        Stats::instance().recordStep(
+            std::chrono::duration<double, std::milli>(Clock::now() - step_start).count());
+        if (interrupted_) {
+            break;
+        }
+        record(feature, result, on_select);
+    }
+
+    if (!checkpoint_path_.empty() && result.size() > checkpoint_size_) {
+        saveCheckpoint(result);
+    }
+    return result;
+}
+
+// Checked between candidates, so a step overruns the deadline by about one MI computation.
+bool FeatureSelector::shouldStop()
+{
+    if (interrupted_.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    if ((stop_ != nullptr && stop_->load(std::memory_order_relaxed))
+        || (deadline_ && Clock::now() >= *deadline_)) {
+        interrupted_ = true;
+        return true;
+    }
+    return false;
+}
+
+// Commits a decided feature: updates the state, streams it and saves the checkpoint.
+void FeatureSelector::record(SelectedFeature feature,
+                             std::vector<SelectedFeature> &result,
+                             const Callback &on_select)
+{
+    feature.elapsed_ms = std::chrono::duration<double, std::milli>(Clock::now() - start_).count();
+    selected_.push_back(feature.index);
+    selected_mask_[feature.index] = true;
+    result.push_back(feature);
+    if (on_select) {
+        on_select(feature);
+    }
+    if (!checkpoint_path_.empty() && Clock::now() - checkpoint_time_ >= checkpoint_interval_) {
+        saveCheckpoint(result);
+    }
+}
+
+/**
+ * Restores the state saved after the last decided feature of a previous run on the same data,
+ * class and criterion. Anything else, including a missing file, starts from scratch.
+ */
+bool FeatureSelector::loadCheckpoint(std::vector<SelectedFeature> &result)
+{
+    if (checkpoint_path_.empty()) {
+        return false;
+    }
+    std::ifstream in(checkpoint_path_, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+
+    const std::uint32_t features_size = raw_data_.getFeaturesSize();
+    CheckpointHeader header{};
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header))
+        || std::memcmp(header.magic, kCheckpointMagic, sizeof(kCheckpointMagic)) != 0
+        || header.version != kCheckpointVersion
+        || header.content_hash != raw_data_.getContentHash()
+        || header.features_size != features_size || header.class_index != class_index_
+        || header.criterion != static_cast<std::uint32_t>(criterion_) || header.selected_size == 0
+        || header.selected_size > features_size) {
+        return false;
+    }
+
+    std::vector<CheckpointEntry> entries(header.selected_size);
+    std::vector<double> relevances(features_size);
+    std::vector<double> accumulated(features_size);
+    std::vector<double> partial_scores(features_size);
+    std::vector<std::uint32_t> evaluated(features_size);
+    auto read = [&in](auto &values) {
+        return static_cast<bool>(
+            in.read(reinterpret_cast<char *>(values.data()),
+                    static_cast<std::streamsize>(values.size() * sizeof(values[0]))));
+    };
+    if (!read(entries) || !read(relevances) || !read(accumulated) || !read(partial_scores)
+        || !read(evaluated)) {
+        return false;
+    }
+    for (const CheckpointEntry &entry : entries) {
+        if (entry.index >= features_size) {
+            return false;
+        }
+    }
+
+    relevances_ = std::move(relevances);
+    accumulated_ = std::move(accumulated);
+    partial_scores_ = std::move(partial_scores);
+    evaluated_ = std::move(evaluated);
+    for (const CheckpointEntry &entry : entries) {
+        selected_.push_back(entry.index);
+        selected_mask_[entry.index] = true;
+        result.push_back({entry.index, entry.score, entry.elapsed_ms});
+    }
+    return true;
+}
+
+// Written to a temporary file and renamed, so a run killed mid-write keeps the previous one.
+void FeatureSelector::saveCheckpoint(const std::vector<SelectedFeature> &result)
+{
+    CheckpointHeader header{};
+    std::memcpy(header.magic, kCheckpointMagic, sizeof(kCheckpointMagic));
+    header.version = kCheckpointVersion;
+    header.content_hash = raw_data_.getContentHash();
+    header.features_size = raw_data_.getFeaturesSize();
+    header.class_index = class_index_;
+    header.criterion = static_cast<std::uint32_t>(criterion_);
+    header.selected_size = static_cast<std::uint32_t>(result.size());
+
+    std::vector<CheckpointEntry> entries;
+    for (const SelectedFeature &feature : result) {
+        entries.push_back({feature.index, 0, feature.score, feature.elapsed_ms});
+    }
+
+    const std::string temporary = checkpoint_path_ + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Could not open file: " + temporary);
+        }
+        auto write = [&out](const auto &values) {
+            out.write(reinterpret_cast<const char *>(values.data()),
+                      static_cast<std::streamsize>(values.size() * sizeof(values[0])));
+        };
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        write(entries);
+        write(relevances_);
+        write(accumulated_);
+        write(partial_scores_);
+        write(evaluated_);
+        if (!out) {
+            throw std::runtime_error("Failed to write file: " + temporary);
+        }
+    }
+    std::filesystem::rename(temporary, checkpoint_path_);
+    checkpoint_time_ = Clock::now();
+    checkpoint_size_ = result.size();
+}
+
+// Get relevances between all features and class.
+void FeatureSelector::computeRelevances()
+{
+    relevances_.assign(raw_data_.getFeaturesSize(), 0.0);
+    parallelForPlaced(
+        relevances_.size(),
+        threads_,
+        [this](std::size_t i) { return raw_data_.getColumnNode(static_cast<std::uint32_t>(i)); },
+        [this](std::size_t i) {
+            if (candidates_[i] && !shouldStop()) {
+                relevances_[i] = mutual_info_.fetch(class_index_, static_cast<std::uint32_t>(i));
+            }
+        });
+}
+
+bool FeatureSelector::isCandidate(std::uint32_t index) const
+{
+    return candidates_[index] && !selected_mask_[index];
+}
+
+// Max relevance feature is added first because no redundancy is possible.
+SelectedFeature FeatureSelector::selectFirst() const
+{
+    SelectedFeature best{0, -std::numeric_limits<double>::infinity()};
+    for (std::uint32_t i = 0; i < relevances_.size(); ++i) {
+        if (isCandidate(i) && relevances_[i] > best.score) {
+            best = {i, relevances_[i]};
+        }
+    }
+    return best;
+}
+
+// mRMR and JMI only need the terms involving the last selected feature at each step, which are
+// accumulated on top of the previous ones. Candidates are independent, so they are scored in
+// parallel, each on the NUMA node holding it, and the best one is picked afterwards in index
+// order.
+SelectedFeature FeatureSelector::stepAccumulated(std::uint32_t last_feature)
+{
+    double selected_size = static_cast<double>(selected_.size());
+    auto node_of = [this](std::size_t index) {
+        return raw_data_.getColumnNode(static_cast<std::uint32_t>(index));
+    };
+
+    parallelForPlaced(scores_.size(), threads_, node_of, [&](std::size_t index) {
+        std::uint32_t j = static_cast<std::uint32_t>(index);
+        if (!isCandidate(j) || shouldStop()) {
+            return;
+        }
+
+        if (criterion_ == Criterion::MRMR) {
+            terms_[j] = mutual_info_.fetch(last_feature, j);
+            scores_[j] = relevances_[j] - ((accumulated_[j] + terms_[j]) / selected_size);
+        } else {
+            // I(X,S;C) = I(S;C) + I(X;C|S)
+            terms_[j] = relevances_[last_feature]
+                        + mutual_info_.fetchConditional(j, class_index_, last_feature);
+            scores_[j] = accumulated_[j] + terms_[j];
+        }
+    });
+
+    // An abandoned step leaves the state as it was, so it can still be checkpointed
+    SelectedFeature best{0, -std::numeric_limits<double>::infinity()};
+    if (interrupted_) {
+        return best;
+    }
+    for (std::uint32_t j = 0; j < scores_.size(); ++j) {
+        if (isCandidate(j)) {
+            accumulated_[j] += terms_[j];
+            if (scores_[j] > best.score) {
+                best = {j, scores_[j]};
+            }
+        }
+    }
+    return best;
+}
+
+// Fast CMIM (Fleuret, 2004): a candidate's score can only decrease as features are selected,
+// so its partial minimum is only refined while it could still beat the best score seen in
+// this step. Most candidates are discarded after a handful of conditional MI evaluations.
+SelectedFeature FeatureSelector::stepCmim()
+{
+    SelectedFeature best{0, -std::numeric_limits<double>::infinity()};
+
+    for (std::uint32_t j = 0; j < raw_data_.getFeaturesSize(); ++j) {
+        if (!isCandidate(j)) {
+            continue;
+        }
+        if (shouldStop()) {
+            break;
+        }
+
+        while (partial_scores_[j] > best.score && evaluated_[j] < selected_.size()) {
+            double conditional =
+                mutual_info_.fetchConditional(j, class_index_, selected_[evaluated_[j]]);
+            partial_scores_[j] = std::min(partial_scores_[j], conditional);
+            evaluated_[j]++;
+        }
+
+        if (partial_scores_[j] > best.score) {
+            best = {j, partial_scores_[j]};
+        }
+    }
+    return best;
+}
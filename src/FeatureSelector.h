@@ -0,0 +1,110 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "MutualInfo.h"
+#include "RawData.h"
+
+// Scoring criterion used by the greedy forward selection.
+enum class Criterion {
+    MRMR,  // I(X;C) - mean over S of I(X;S)
+    JMI,   // sum over S of I(X,S;C)
+    CMIM   // min over S of I(X;C|S)
+};
+
+Criterion parseCriterion(const std::string &name);
+std::string criterionName(Criterion criterion);
+std::vector<bool> candidateFeatures(const RawData &rd, std::uint32_t class_index);
+
+struct SelectedFeature {
+    std::uint32_t index;
+    double score;
+    // Time since select() started when the feature was decided.
+    double elapsed_ms = 0.0;
+};
+
+class FeatureSelector
+{
+  public:
+    using Callback = std::function<void(const SelectedFeature &)>;
+    using Clock = std::chrono::steady_clock;
+
+    FeatureSelector(RawData &rd, MutualInfo &mi, std::uint32_t class_index, Criterion criterion);
+
+    void setThreads(std::uint32_t threads);
+    void setDeadline(std::optional<Clock::time_point> deadline);
+    void setStopFlag(const std::atomic<bool> *stop);
+    void setCheckpoint(std::string path, Clock::duration interval = std::chrono::seconds(10));
+
+    std::vector<SelectedFeature> select(std::uint32_t count, const Callback &on_select = nullptr);
+    bool wasInterrupted() const;
+
+  private:
+    void computeRelevances();
+    SelectedFeature selectFirst() const;
+    SelectedFeature stepAccumulated(std::uint32_t last_feature);
+    SelectedFeature stepCmim();
+    bool isCandidate(std::uint32_t index) const;
+    bool shouldStop();
+    void record(SelectedFeature feature,
+                std::vector<SelectedFeature> &result,
+                const Callback &on_select);
+    bool loadCheckpoint(std::vector<SelectedFeature> &result);
+    void saveCheckpoint(const std::vector<SelectedFeature> &result);
+
+    RawData &raw_data_;
+    MutualInfo &mutual_info_;
+    std::uint32_t class_index_;
+    Criterion criterion_;
+    std::uint32_t threads_;
+
+    // Anytime selection: the run stops at the deadline or when *stop_ becomes true, keeping the
+    // features decided so far, and can resume from the checkpoint. The checkpoint is written at
+    // most once per interval and when select() returns.
+    std::optional<Clock::time_point> deadline_;
+    const std::atomic<bool> *stop_;
+    std::string checkpoint_path_;
+    Clock::duration checkpoint_interval_;
+    Clock::time_point checkpoint_time_;
+    std::size_t checkpoint_size_;
+    std::atomic<bool> interrupted_;
+    Clock::time_point start_;
+
+    std::vector<double> relevances_;
+    // Running sum of I(X;S) for mRMR or of I(X,S;C) for JMI, and the terms of the current step,
+    // which are only added once the step completes.
+    std::vector<double> accumulated_;
+    std::vector<double> terms_;
+    std::vector<double> scores_;
+    // Fast CMIM state: partial minimum and how many selected features it already covers.
+    std::vector<double> partial_scores_;
+    std::vector<std::uint32_t> evaluated_;
+    // Features that may be selected at all, see candidateFeatures().
+    std::vector<bool> candidates_;
+    std::uint32_t candidates_size_;
+    std::vector<bool> selected_mask_;
+    std::vector<std::uint32_t> selected_;
+};
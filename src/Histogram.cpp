@@ -17,24 +17,46 @@
 
 #include "Histogram.h"
 
+#include "Stats.h"
+#include "Workspace.h"
+
 Histogram::Histogram(RawData &rd) noexcept
     : rawData(rd)
 {
 }
 
-// Calculates the histogram for the given feature index.
-std::vector<std::uint32_t> Histogram::getHistogram(std::uint32_t index) const
+// Calculates the histogram for the given feature index. Sparse features only visit their
+// non-zero entries; the zero bin is whatever is left.
+std::span<const std::uint64_t> Histogram::getHistogram(std::uint32_t index) const
 {
     std::uint32_t valueRange = rawData.getValuesRange(index);
-    std::vector<std::uint8_t> featureData = rawData.fetchFeature(index);
-    std::vector<std::uint32_t> histogram(valueRange, 0);
+    std::span<std::uint64_t> histogram =
+        Workspace::local().wideTable(Workspace::Table::Histogram, valueRange);
+
+    if (rawData.isSparse(index)) {
+        const SparseColumn &sparse = rawData.getSparseColumn(index);
+        for (std::uint8_t value : sparse.values) {
+            histogram[value]++;
+        }
+        histogram[0] = rawData.getDataSize() - sparse.values.size();
+
+        Stats::instance().add(Stats::Counter::HistogramsBuilt);
+        Stats::instance().add(Stats::Counter::BytesScanned, sparse.values.size());
+        return histogram;
+    }
+
+    const std::uint8_t *featureData = rawData.getColumn(index);
 
     // Calculate histogram
-    for (std::uint32_t i = 0; i < rawData.getDataSize(); i++) {
-        if (i < featureData.size() && featureData[i] < valueRange) {
+    const std::uint64_t dataSize = rawData.getDataSize();
+    for (std::size_t i = 0; i < dataSize; i++) {
+        if (featureData[i] < valueRange) {
             histogram[featureData[i]]++;
         }
     }
 
+    Stats::instance().add(Stats::Counter::HistogramsBuilt);
+    Stats::instance().add(Stats::Counter::BytesScanned, dataSize);
+
     return histogram;
-}
\ No newline at end of file
+}
@@ -17,7 +17,7 @@
 
 #pragma once
 
-#include <vector>
+#include <span>
 
 #include "RawData.h"
 
@@ -26,7 +26,9 @@ class Histogram
   public:
     Histogram(RawData &rd) noexcept;
 
-    std::vector<std::uint32_t> getHistogram(std::uint32_t index) const;
+    // The returned counts are borrowed from the calling thread's Workspace and stay valid until
+    // the next call on the same thread.
+    std::span<const std::uint64_t> getHistogram(std::uint32_t index) const;
 
   private:
     RawData &rawData;
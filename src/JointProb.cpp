@@ -19,45 +19,211 @@
 
 #include <stdexcept>
 
+#include "Stats.h"
+#include "Workspace.h"
+
 JointProb::JointProb(RawData &raw_data, std::uint32_t index1, std::uint32_t index2)
     : raw_data_(raw_data),
       index1_(index1),
       index2_(index2),
+      index3_(0),
       values_range1_(raw_data.getValuesRange(index1)),
       values_range2_(raw_data.getValuesRange(index2)),
-      data_size_(raw_data.getDataSize())
+      values_range3_(1),
+      data_size_(raw_data.getDataSize()),
+      three_way_(false),
+      wide_(data_size_ > UINT32_MAX)
 {
-    // Initialize vector with zeros
-    data_.resize(values_range1_ * values_range2_, 0);
-    calculate();
+    build(static_cast<std::size_t>(values_range1_) * values_range2_);
+}
+
+// Three-way table used by the conditional criteria: all cells are filled in a single pass
+// over the rows, so the pairwise marginals can be derived from it without rescanning.
+JointProb::JointProb(RawData &raw_data,
+                     std::uint32_t index1,
+                     std::uint32_t index2,
+                     std::uint32_t index3)
+    : raw_data_(raw_data),
+      index1_(index1),
+      index2_(index2),
+      index3_(index3),
+      values_range1_(raw_data.getValuesRange(index1)),
+      values_range2_(raw_data.getValuesRange(index2)),
+      values_range3_(raw_data.getValuesRange(index3)),
+      data_size_(raw_data.getDataSize()),
+      three_way_(true),
+      wide_(data_size_ > UINT32_MAX)
+{
+    build(static_cast<std::size_t>(values_range1_) * values_range2_ * values_range3_);
+}
+
+// Borrows a zeroed table of the given size, with 64-bit counts only when 32 bits could
+// overflow, and fills it.
+void JointProb::build(std::size_t size)
+{
+    if (wide_) {
+        wide_data_ = Workspace::local().wideTable(Workspace::Table::Joint, size);
+        calculate(wide_data_);
+    } else {
+        data_ = Workspace::local().table(Workspace::Table::Joint, size);
+        calculate(data_);
+    }
 }
 
 // Calculates the joint probability between the given features.
-void JointProb::calculate()
+template <typename Count>
+void JointProb::calculate(std::span<Count> table)
 {
-    std::vector<std::uint8_t> h_vector1 = raw_data_.fetchFeature(index1_);
-    std::vector<std::uint8_t> h_vector2 = raw_data_.fetchFeature(index2_);
+    if (three_way_) {
+        // Sparse features are materialized into scratch columns for the three-way kernel
+        Workspace &workspace = Workspace::local();
+        const std::uint8_t *h_vector1 =
+            raw_data_.fetchFeature(index1_, workspace, Workspace::Column::First);
+        const std::uint8_t *h_vector2 =
+            raw_data_.fetchFeature(index2_, workspace, Workspace::Column::Second);
+        const std::uint8_t *h_vector3 =
+            raw_data_.fetchFeature(index3_, workspace, Workspace::Column::Third);
+        const std::size_t stride1 = static_cast<std::size_t>(values_range2_) * values_range3_;
+
+        for (std::size_t i = 0; i < data_size_; i++) {
+            table[h_vector1[i] * stride1 + h_vector2[i] * values_range3_ + h_vector3[i]]++;
+        }
+
+        Stats::instance().add(Stats::Counter::JointTablesBuilt);
+        Stats::instance().add(Stats::Counter::BytesScanned, 3ull * data_size_);
+        return;
+    }
+
+    if (raw_data_.isSparse(index1_) || raw_data_.isSparse(index2_)) {
+        calculateSparse(table);
+        return;
+    }
+
+    const std::uint8_t *h_vector1 = raw_data_.getColumn(index1_);
+    const std::uint8_t *h_vector2 = raw_data_.getColumn(index2_);
 
     // Calculate histogram in CPU
-    for (std::uint32_t i = 0; i < data_size_; i++) {
-        // Access vectors with bounds checking
-        if (i < h_vector1.size() && i < h_vector2.size()) {
-            std::uint32_t index = h_vector1[i] * values_range2_ + h_vector2[i];
-            if (index < data_.size()) {
-                data_[index]++;
+    for (std::size_t i = 0; i < data_size_; i++) {
+        table[h_vector1[i] * values_range2_ + h_vector2[i]]++;
+    }
+
+    Stats::instance().add(Stats::Counter::JointTablesBuilt);
+    Stats::instance().add(Stats::Counter::BytesScanned, 2ull * data_size_);
+}
+
+// Joint histogram when at least one feature is sparse. Only the rows where a sparse feature is
+// non-zero are visited; the cells involving its zero value are derived from the marginal
+// counts, so the cost is proportional to the number of non-zeros instead of data_size_.
+template <typename Count>
+void JointProb::calculateSparse(std::span<Count> table)
+{
+    const bool sparse1 = raw_data_.isSparse(index1_);
+    const bool sparse2 = raw_data_.isSparse(index2_);
+    const std::vector<std::uint64_t> &counts1 = raw_data_.getValueCounts(index1_);
+    const std::vector<std::uint64_t> &counts2 = raw_data_.getValueCounts(index2_);
+    std::uint64_t entries = 0;
+
+    if (sparse1 && sparse2) {
+        // Both sparse: only rows non-zero in both contribute to the x != 0, y != 0 block.
+        const SparseColumn &column1 = raw_data_.getSparseColumn(index1_);
+        const SparseColumn &column2 = raw_data_.getSparseColumn(index2_);
+        std::size_t a = 0;
+        std::size_t b = 0;
+        while (a < column1.rows.size() && b < column2.rows.size()) {
+            if (column1.rows[a] < column2.rows[b]) {
+                a++;
+            } else if (column1.rows[a] > column2.rows[b]) {
+                b++;
+            } else {
+                table[column1.values[a++] * values_range2_ + column2.values[b++]]++;
             }
         }
+        entries = column1.rows.size() + column2.rows.size();
+
+        std::uint64_t assigned = 0;
+        for (std::uint32_t x = 1; x < values_range1_; x++) {
+            std::uint64_t row_sum = 0;
+            for (std::uint32_t y = 1; y < values_range2_; y++) {
+                row_sum += table[x * values_range2_ + y];
+            }
+            table[x * values_range2_] = counts1[x] - row_sum;
+            assigned += counts1[x];
+        }
+        for (std::uint32_t y = 1; y < values_range2_; y++) {
+            std::uint64_t column_sum = 0;
+            for (std::uint32_t x = 1; x < values_range1_; x++) {
+                column_sum += table[x * values_range2_ + y];
+            }
+            table[y] = counts2[y] - column_sum;
+            assigned += table[y];
+        }
+        table[0] = data_size_ - assigned;
+    } else if (sparse1) {
+        // Rows x != 0 are counted exactly, row x = 0 is the dense marginal minus them.
+        const SparseColumn &column1 = raw_data_.getSparseColumn(index1_);
+        const std::uint8_t *column2 = raw_data_.getColumn(index2_);
+        for (std::size_t k = 0; k < column1.rows.size(); k++) {
+            table[column1.values[k] * values_range2_ + column2[column1.rows[k]]]++;
+        }
+        entries = column1.rows.size();
+
+        for (std::uint32_t y = 0; y < values_range2_; y++) {
+            std::uint64_t column_sum = 0;
+            for (std::uint32_t x = 1; x < values_range1_; x++) {
+                column_sum += table[x * values_range2_ + y];
+            }
+            table[y] = counts2[y] - column_sum;
+        }
+    } else {
+        const std::uint8_t *column1 = raw_data_.getColumn(index1_);
+        const SparseColumn &column2 = raw_data_.getSparseColumn(index2_);
+        for (std::size_t k = 0; k < column2.rows.size(); k++) {
+            table[column1[column2.rows[k]] * values_range2_ + column2.values[k]]++;
+        }
+        entries = column2.rows.size();
+
+        for (std::uint32_t x = 0; x < values_range1_; x++) {
+            std::uint64_t row_sum = 0;
+            for (std::uint32_t y = 1; y < values_range2_; y++) {
+                row_sum += table[x * values_range2_ + y];
+            }
+            table[x * values_range2_] = counts1[x] - row_sum;
+        }
     }
+
+    Stats::instance().add(Stats::Counter::JointTablesBuilt);
+    Stats::instance().add(Stats::Counter::BytesScanned,
+                          entries * (sizeof(SparseColumn::Row) + 2 * sizeof(std::uint8_t)));
 }
 
 double JointProb::fetchProbability(std::uint8_t value_feature1, std::uint8_t value_feature2) const
 {
-    std::uint32_t index = value_feature1 * values_range2_ + value_feature2;
+    std::size_t index = static_cast<std::size_t>(value_feature1) * values_range2_ + value_feature2;
 
     // Add bounds checking for safety
-    if (index >= data_.size()) {
+    if (index >= (wide_ ? wide_data_.size() : data_.size())) {
+        throw std::out_of_range("Index out of range in JointProb::getProb");
+    }
+
+    return static_cast<double>(count(index)) / static_cast<double>(data_size_);
+}
+
+double JointProb::fetchProbability(std::uint8_t value_feature1,
+                                   std::uint8_t value_feature2,
+                                   std::uint8_t value_feature3) const
+{
+    std::size_t index = static_cast<std::size_t>(value_feature1) * values_range2_ + value_feature2;
+    index = index * values_range3_ + value_feature3;
+
+    if (index >= (wide_ ? wide_data_.size() : data_.size())) {
         throw std::out_of_range("Index out of range in JointProb::getProb");
     }
 
-    return static_cast<double>(data_[index]) / static_cast<double>(data_size_);
-}
\ No newline at end of file
+    return static_cast<double>(count(index)) / static_cast<double>(data_size_);
+}
+
+// Count of a cell, whichever width the table has.
+std::uint64_t JointProb::count(std::size_t index) const
+{
+    return wide_ ? wide_data_[index] : data_[index];
+}
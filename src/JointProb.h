@@ -17,26 +17,43 @@
 
 #pragma once
 
+#include <span>
 #include <stdfloat>
-#include <vector>
 
 #include "RawData.h"
 
+// Joint histogram of two or three features. The counts live in the calling thread's Workspace,
+// so only one JointProb may be alive per thread at a time.
 class JointProb
 {
   public:
     JointProb(RawData &rd, std::uint32_t index1, std::uint32_t index2);
+    JointProb(RawData &rd, std::uint32_t index1, std::uint32_t index2, std::uint32_t index3);
 
     double fetchProbability(std::uint8_t value_feature1, std::uint8_t value_feature2) const;
+    double fetchProbability(std::uint8_t value_feature1,
+                            std::uint8_t value_feature2,
+                            std::uint8_t value_feature3) const;
 
   private:
     RawData &raw_data_;
     std::uint32_t index1_;
     std::uint32_t index2_;
-    std::vector<std::uint32_t> data_;
+    std::uint32_t index3_;
+    // Counts are 32-bit unless the dataset has more rows than that can count.
+    std::span<std::uint32_t> data_;
+    std::span<std::uint64_t> wide_data_;
     std::uint32_t values_range1_;
     std::uint32_t values_range2_;
-    std::uint32_t data_size_;
+    std::uint32_t values_range3_;
+    std::uint64_t data_size_;
+    bool three_way_;
+    bool wide_;
 
-    void calculate();
-};
\ No newline at end of file
+    void build(std::size_t size);
+    template <typename Count>
+    void calculate(std::span<Count> data);
+    template <typename Count>
+    void calculateSparse(std::span<Count> data);
+    std::uint64_t count(std::size_t index) const;
+};
@@ -18,8 +18,12 @@
 #include "MutualInfo.h"
 
 #include <cmath>
+#include <span>
 
 #include "JointProb.h"
+#include "Sidecar.h"
+#include "Stats.h"
+#include "Workspace.h"
 
 MutualInfo::MutualInfo(RawData &rd, ProbTable &pt)
     : raw_data_(rd),
@@ -27,12 +31,24 @@ MutualInfo::MutualInfo(RawData &rd, ProbTable &pt)
 {
 }
 
+// Looks terms up in, and records new terms to, the given sidecar. Pass nullptr to disable.
+void MutualInfo::setCache(Sidecar *sidecar)
+{
+    cache_ = sidecar;
+}
+
 // Calculates the mutual information between the given features.
 double MutualInfo::fetch(std::uint32_t feature_index1, std::uint32_t feature_index2) const
 {
+    double mutual_info = 0;
+    if (cache_ != nullptr
+        && cache_->find(feature_index1, feature_index2, Sidecar::kNone, mutual_info)) {
+        return mutual_info;
+    }
+
     std::uint32_t range1 = raw_data_.getValuesRange(feature_index1);
     std::uint32_t range2 = raw_data_.getValuesRange(feature_index2);
-    double mutual_info = 0;
+    std::uint64_t marginal_lookups = 0;
     constexpr double epsilon = 1e-10;  // Small value to avoid division by zero
 
     JointProb joint_probability_table = JointProb(raw_data_, feature_index1, feature_index2);
@@ -44,6 +60,7 @@ double MutualInfo::fetch(std::uint32_t feature_index1, std::uint32_t feature_ind
             if (joint_probability > epsilon) {  // Avoid log(~0) which is undefined
                 double marginalX = prob_table_.fetchProbability(feature_index1, i);
                 double marginalY = prob_table_.fetchProbability(feature_index2, j);
+                marginal_lookups += 2;
 
                 // Check for zero probabilities to avoid division by zero
                 if (marginalX > 0 && marginalY > 0) {
@@ -54,5 +71,72 @@ double MutualInfo::fetch(std::uint32_t feature_index1, std::uint32_t feature_ind
         }
     }
 
+    Stats::instance().add(Stats::Counter::MutualInfoCalls);
+    Stats::instance().add(Stats::Counter::MarginalLookups, marginal_lookups);
+    if (cache_ != nullptr) {
+        cache_->insert(feature_index1, feature_index2, Sidecar::kNone, mutual_info);
+    }
+
+    return mutual_info;
+}
+
+// Calculates the conditional mutual information I(index1; index2 | condition). The three-way
+// table is built in one pass and the pairwise marginals are folded out of it, so the cost is
+// a single scan over the rows, the same as fetch().
+double MutualInfo::fetchConditional(std::uint32_t feature_index1,
+                                    std::uint32_t feature_index2,
+                                    std::uint32_t condition) const
+{
+    double mutual_info = 0;
+    if (cache_ != nullptr
+        && cache_->find(feature_index1, feature_index2, condition, mutual_info)) {
+        return mutual_info;
+    }
+
+    std::uint32_t range1 = raw_data_.getValuesRange(feature_index1);
+    std::uint32_t range2 = raw_data_.getValuesRange(feature_index2);
+    std::uint32_t range3 = raw_data_.getValuesRange(condition);
+    std::uint64_t marginal_lookups = 0;
+    constexpr double epsilon = 1e-10;
+
+    JointProb joint_probability_table =
+        JointProb(raw_data_, feature_index1, feature_index2, condition);
+
+    // p(x, z) and p(y, z) marginalized from the joint table
+    Workspace &workspace = Workspace::local();
+    std::span<double> marginal_xz = workspace.buffer(Workspace::Buffer::Marginal1, range1 * range3);
+    std::span<double> marginal_yz = workspace.buffer(Workspace::Buffer::Marginal2, range2 * range3);
+    for (std::uint32_t i = 0; i < range1; i++) {
+        for (std::uint32_t j = 0; j < range2; j++) {
+            for (std::uint32_t k = 0; k < range3; k++) {
+                double joint_probability = joint_probability_table.fetchProbability(i, j, k);
+                marginal_xz[i * range3 + k] += joint_probability;
+                marginal_yz[j * range3 + k] += joint_probability;
+            }
+        }
+    }
+
+    for (std::uint32_t i = 0; i < range1; i++) {
+        for (std::uint32_t j = 0; j < range2; j++) {
+            for (std::uint32_t k = 0; k < range3; k++) {
+                double joint_probability = joint_probability_table.fetchProbability(i, j, k);
+
+                if (joint_probability > epsilon) {
+                    double marginalZ = prob_table_.fetchProbability(condition, k);
+                    marginal_lookups++;
+                    double division = (marginalZ * joint_probability)
+                                      / (marginal_xz[i * range3 + k] * marginal_yz[j * range3 + k]);
+                    mutual_info += joint_probability * std::log2(division);
+                }
+            }
+        }
+    }
+
+    Stats::instance().add(Stats::Counter::MutualInfoCalls);
+    Stats::instance().add(Stats::Counter::MarginalLookups, marginal_lookups);
+    if (cache_ != nullptr) {
+        cache_->insert(feature_index1, feature_index2, condition, mutual_info);
+    }
+
     return mutual_info;
-}
\ No newline at end of file
+}
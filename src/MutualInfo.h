@@ -19,14 +19,22 @@
 
 #include "ProbTable.h"
 
+class Sidecar;
+
 class MutualInfo
 {
   public:
     MutualInfo(RawData &rd, ProbTable &pt);
 
+    void setCache(Sidecar *sidecar);
+
     double fetch(std::uint32_t index1, std::uint32_t index2) const;
+    double fetchConditional(std::uint32_t index1,
+                            std::uint32_t index2,
+                            std::uint32_t condition) const;
 
   private:
     RawData &raw_data_;
     ProbTable &prob_table_;
+    Sidecar *cache_ = nullptr;
 };
@@ -0,0 +1,336 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MutualInfoMatrix.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <utility>
+
+#include "Parallel.h"
+#include "RawData.h"
+#include "Stats.h"
+#include "Workspace.h"
+
+namespace
+{
+constexpr char kMagic[4] = {'M', 'R', 'M', 'I'};
+constexpr std::uint16_t kVersion = 1;
+
+// Sum of the value ranges of the features in a tile. The joint tables of a tile pair then take
+// at most kTileValues^2 32-bit counters (1 MiB), which stay in cache while the rows stream by.
+constexpr std::uint32_t kTileValues = 512;
+// Bytes of the two tiles' columns processed per chunk of rows, and the chunk granularity.
+constexpr std::size_t kChunkBytes = std::size_t{256} << 10;
+constexpr std::size_t kChunkAlign = 64;
+
+template <typename T>
+void put(std::vector<std::uint8_t> &out, T value)
+{
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+        out.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+    }
+}
+}  // namespace
+
+MutualInfoMatrix::MutualInfoMatrix(const RawData &rd)
+    : raw_data_(rd),
+      features_size_(rd.getFeaturesSize()),
+      values_(static_cast<std::size_t>(features_size_) * (features_size_ + 1) / 2, 0.0f),
+      stop_(nullptr),
+      interrupted_(false)
+{
+}
+
+// Stops compute() once the deadline passes.
+void MutualInfoMatrix::setDeadline(std::optional<Clock::time_point> deadline)
+{
+    deadline_ = deadline;
+}
+
+// Stops compute() as soon as *stop becomes true. Setting it from a signal handler is safe.
+void MutualInfoMatrix::setStopFlag(const std::atomic<bool> *stop)
+{
+    stop_ = stop;
+}
+
+// Whether the last compute() stopped early, leaving part of the matrix unset.
+bool MutualInfoMatrix::wasInterrupted() const
+{
+    return interrupted_.load();
+}
+
+// Checked between chunks of rows, so compute() overruns the deadline by about one chunk.
+bool MutualInfoMatrix::shouldStop()
+{
+    if (interrupted_.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    if ((stop_ != nullptr && stop_->load(std::memory_order_relaxed))
+        || (deadline_ && Clock::now() >= *deadline_)) {
+        interrupted_ = true;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Computes every entry of the matrix. Features are grouped into tiles, and for each pair of
+ * tiles all their joint histograms are filled in a single sweep over the rows, so each column
+ * is read once per tile pair instead of once per feature pair. Tile pairs run in parallel.
+ * When the deadline passes or the stop flag is raised, the remaining entries are left unset.
+ *
+ * @param threads Number of worker threads
+ */
+void MutualInfoMatrix::compute(std::uint32_t threads)
+{
+    ScopedPhase phase("mi_matrix");
+    interrupted_ = false;
+
+    std::vector<Tile> tiles = makeTiles();
+    std::vector<std::pair<std::size_t, std::size_t>> tile_pairs;
+    for (std::size_t a = 0; a < tiles.size(); ++a) {
+        for (std::size_t b = a; b < tiles.size(); ++b) {
+            tile_pairs.emplace_back(a, b);
+        }
+    }
+
+    parallelFor(tile_pairs.size(), threads, [&](std::size_t k) {
+        if (shouldStop()) {
+            return;
+        }
+        computeTilePair(tiles[tile_pairs[k].first], tiles[tile_pairs[k].second]);
+    });
+}
+
+std::vector<MutualInfoMatrix::Tile> MutualInfoMatrix::makeTiles() const
+{
+    std::vector<Tile> tiles;
+    std::uint32_t values = 0;
+    for (std::uint32_t i = 0; i < features_size_; ++i) {
+        std::uint32_t range = raw_data_.getValuesRange(i);
+        if (tiles.empty() || values + range > kTileValues) {
+            tiles.push_back({i, i + 1});
+            values = range;
+        } else {
+            tiles.back().end = i + 1;
+            values += range;
+        }
+    }
+    return tiles;
+}
+
+void MutualInfoMatrix::computeTilePair(const Tile &tile1, const Tile &tile2)
+{
+    const bool same_tile = tile1.begin == tile2.begin;
+    const std::uint64_t data_size = raw_data_.getDataSize();
+
+    // Features whose chunks are needed: tile1, then tile2 unless it is the same tile
+    std::vector<std::uint32_t> features;
+    for (std::uint32_t i = tile1.begin; i < tile1.end; ++i) {
+        features.push_back(i);
+    }
+    if (!same_tile) {
+        for (std::uint32_t i = tile2.begin; i < tile2.end; ++i) {
+            features.push_back(i);
+        }
+    }
+    const std::size_t slot2 = same_tile ? 0 : tile1.end - tile1.begin;
+
+    // One joint table per feature pair (i, j), i <= j, laid out back to back
+    struct Pair {
+        std::uint32_t slot1;
+        std::uint32_t slot2;
+        std::size_t table;
+    };
+    std::vector<Pair> pairs;
+    std::size_t table_size = 0;
+    for (std::uint32_t i = tile1.begin; i < tile1.end; ++i) {
+        for (std::uint32_t j = same_tile ? i : tile2.begin; j < tile2.end; ++j) {
+            pairs.push_back({i - tile1.begin,
+                             static_cast<std::uint32_t>(slot2 + j - tile2.begin),
+                             table_size});
+            table_size += static_cast<std::size_t>(raw_data_.getValuesRange(i))
+                          * raw_data_.getValuesRange(j);
+        }
+    }
+
+    // Chunks are far shorter than 2^32 rows, so 32-bit counters are enough per chunk. Datasets
+    // with more rows fold every chunk into 64-bit totals; the others count straight through.
+    Workspace &workspace = Workspace::local();
+    std::span<std::uint32_t> tables = workspace.table(Workspace::Table::Joint, table_size);
+    const bool wide = data_size > UINT32_MAX;
+    std::span<std::uint64_t> totals;
+    if (wide) {
+        totals = workspace.wideTable(Workspace::Table::Joint, table_size);
+    }
+
+    const std::size_t chunk_rows =
+        std::max(kChunkAlign, kChunkBytes / features.size() / kChunkAlign * kChunkAlign);
+    std::span<std::uint8_t> scratch = workspace.column(
+        Workspace::Column::First, features.size() * std::min<std::uint64_t>(chunk_rows, data_size));
+    std::vector<const std::uint8_t *> chunks(features.size());
+
+    for (std::uint64_t row = 0; row < data_size; row += chunk_rows) {
+        if (shouldStop()) {
+            return;
+        }
+        const std::size_t rows = std::min<std::uint64_t>(chunk_rows, data_size - row);
+
+        // Dense columns are read in place; sparse ones are expanded for this chunk only
+        for (std::size_t s = 0; s < features.size(); ++s) {
+            const std::uint8_t *column = raw_data_.getColumn(features[s]);
+            if (column != nullptr) {
+                chunks[s] = column + row;
+                continue;
+            }
+            std::uint8_t *expanded = scratch.data() + s * rows;
+            std::memset(expanded, 0, rows);
+            const SparseColumn &sparse = raw_data_.getSparseColumn(features[s]);
+            auto it = std::lower_bound(sparse.rows.begin(), sparse.rows.end(), row);
+            for (std::size_t k = it - sparse.rows.begin();
+                 k < sparse.rows.size() && sparse.rows[k] < row + rows;
+                 ++k) {
+                expanded[sparse.rows[k] - row] = sparse.values[k];
+            }
+            chunks[s] = expanded;
+        }
+
+        for (const Pair &pair : pairs) {
+            const std::uint8_t *values1 = chunks[pair.slot1];
+            const std::uint8_t *values2 = chunks[pair.slot2];
+            const std::uint32_t range2 = raw_data_.getValuesRange(features[pair.slot2]);
+            std::uint32_t *table = tables.data() + pair.table;
+            for (std::size_t r = 0; r < rows; ++r) {
+                table[values1[r] * range2 + values2[r]]++;
+            }
+        }
+
+        if (wide) {
+            for (std::size_t k = 0; k < table_size; ++k) {
+                totals[k] += tables[k];
+            }
+            std::fill(tables.begin(), tables.end(), 0);
+        }
+    }
+    auto count = [&](std::size_t cell) -> std::uint64_t {
+        return wide ? totals[cell] : tables[cell];
+    };
+
+    // Same arithmetic as MutualInfo::fetch, so entries match it up to the float rounding
+    constexpr double epsilon = 1e-10;
+    for (const Pair &pair : pairs) {
+        const std::uint32_t index1 = features[pair.slot1];
+        const std::uint32_t index2 = features[pair.slot2];
+        const std::vector<std::uint64_t> &counts1 = raw_data_.getValueCounts(index1);
+        const std::vector<std::uint64_t> &counts2 = raw_data_.getValueCounts(index2);
+        const std::uint32_t range1 = raw_data_.getValuesRange(index1);
+        const std::uint32_t range2 = raw_data_.getValuesRange(index2);
+
+        double mutual_info = 0;
+        for (std::uint32_t i = 0; i < range1; i++) {
+            for (std::uint32_t j = 0; j < range2; j++) {
+                double joint_probability =
+                    static_cast<double>(count(pair.table + i * range2 + j))
+                    / static_cast<double>(data_size);
+                if (joint_probability > epsilon) {
+                    double marginalX =
+                        static_cast<double>(counts1[i]) / static_cast<double>(data_size);
+                    double marginalY =
+                        static_cast<double>(counts2[j]) / static_cast<double>(data_size);
+                    if (marginalX > 0 && marginalY > 0) {
+                        double division = joint_probability / (marginalX * marginalY);
+                        mutual_info += joint_probability * std::log2(division);
+                    }
+                }
+            }
+        }
+        values_[offset(index1, index2)] = static_cast<float>(mutual_info);
+    }
+
+    Stats::instance().add(Stats::Counter::JointTablesBuilt, pairs.size());
+    Stats::instance().add(Stats::Counter::BytesScanned,
+                          features.size() * data_size);
+}
+
+// Position of (index1, index2), index1 <= index2, in the row-major upper triangle.
+std::size_t MutualInfoMatrix::offset(std::uint32_t index1, std::uint32_t index2) const
+{
+    std::size_t row = index1;
+    return row * features_size_ - row * (row - 1) / 2 + (index2 - index1);
+}
+
+/**
+ * Returns the mutual information between two features, or the entropy of a feature when both
+ * indices are equal, rounded to single precision.
+ */
+double MutualInfoMatrix::get(std::uint32_t index1, std::uint32_t index2) const
+{
+    if (index1 >= features_size_ || index2 >= features_size_) {
+        throw std::out_of_range("Feature index out of range");
+    }
+    if (index1 > index2) {
+        std::swap(index1, index2);
+    }
+    return values_[offset(index1, index2)];
+}
+
+std::uint32_t MutualInfoMatrix::getFeaturesSize() const
+{
+    return features_size_;
+}
+
+/**
+ * Saves the upper triangle of the matrix, one row at a time.
+ *
+ * @param filename Output path
+ */
+void MutualInfoMatrix::write(const std::string &filename) const
+{
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("Could not open file: " + filename);
+    }
+
+    std::vector<std::uint8_t> bytes(kMagic, kMagic + sizeof(kMagic));
+    put<std::uint16_t>(bytes, kVersion);
+    put<std::uint16_t>(bytes, 0);
+    put<std::uint32_t>(bytes, features_size_);
+    out.write(reinterpret_cast<const char *>(bytes.data()),
+              static_cast<std::streamsize>(bytes.size()));
+    bytes.clear();
+
+    for (std::uint32_t i = 0; i < features_size_; ++i) {
+        for (std::uint32_t j = i; j < features_size_; ++j) {
+            float value = values_[offset(i, j)];
+            std::uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            put<std::uint32_t>(bytes, bits);
+        }
+        out.write(reinterpret_cast<const char *>(bytes.data()),
+                  static_cast<std::streamsize>(bytes.size()));
+        bytes.clear();
+    }
+
+    if (!out) {
+        throw std::runtime_error("Failed to write file: " + filename);
+    }
+}
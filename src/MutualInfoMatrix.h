@@ -0,0 +1,77 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+class RawData;
+
+/*
+ * Symmetric matrix of the mutual information between every pair of features, the diagonal
+ * holding each feature's entropy. Entries are kept in single precision, the precision of the
+ * file, so the matrix takes 2 F (F + 1) bytes. Saved as (little-endian):
+ *
+ *   char     magic[4] = "MRMI"
+ *   uint16   version = 1
+ *   uint16   reserved = 0
+ *   uint32   features_size
+ *   float32  upper triangle, row by row: (0,0) (0,1) ... (0,F-1) (1,1) ... (F-1,F-1)
+ */
+class MutualInfoMatrix
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit MutualInfoMatrix(const RawData &rd);
+
+    void setDeadline(std::optional<Clock::time_point> deadline);
+    void setStopFlag(const std::atomic<bool> *stop);
+
+    void compute(std::uint32_t threads);
+    bool wasInterrupted() const;
+    double get(std::uint32_t index1, std::uint32_t index2) const;
+    std::uint32_t getFeaturesSize() const;
+
+    void write(const std::string &filename) const;
+
+  private:
+    // Consecutive features [begin, end) whose joint tables with another tile fit in cache.
+    struct Tile {
+        std::uint32_t begin;
+        std::uint32_t end;
+    };
+
+    std::vector<Tile> makeTiles() const;
+    void computeTilePair(const Tile &tile1, const Tile &tile2);
+    std::size_t offset(std::uint32_t index1, std::uint32_t index2) const;
+    bool shouldStop();
+
+    const RawData &raw_data_;
+    std::uint32_t features_size_;
+    std::vector<float> values_;
+
+    // compute() gives up at the deadline or when *stop_ becomes true.
+    std::optional<Clock::time_point> deadline_;
+    const std::atomic<bool> *stop_;
+    std::atomic<bool> interrupted_;
+};
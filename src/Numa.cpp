@@ -0,0 +1,263 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Numa.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#endif
+
+namespace
+{
+#ifdef __linux__
+// Memory policy mode of mbind(2); spelled out to avoid depending on libnuma headers.
+constexpr int kPolicyPreferred = 1;
+constexpr std::size_t kMaxNodes = 1024;
+
+// Parses a kernel list such as "0-3,8-11".
+std::vector<std::uint32_t> parseList(const std::string &text)
+{
+    std::vector<std::uint32_t> values;
+    std::stringstream ranges(text);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+        if (range.empty() || range == "\n") {
+            continue;
+        }
+        std::size_t dash = range.find('-');
+        std::uint32_t first = static_cast<std::uint32_t>(std::stoul(range.substr(0, dash)));
+        std::uint32_t last = dash == std::string::npos
+                                 ? first
+                                 : static_cast<std::uint32_t>(std::stoul(range.substr(dash + 1)));
+        for (std::uint32_t value = first; value <= last; ++value) {
+            values.push_back(value);
+        }
+    }
+    return values;
+}
+
+std::string readLine(const std::string &path)
+{
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+#endif
+}  // namespace
+
+const NumaTopology &NumaTopology::instance()
+{
+    static NumaTopology topology;
+    return topology;
+}
+
+NumaTopology::NumaTopology()
+{
+#if defined(__linux__)
+    try {
+        for (std::uint32_t id : parseList(readLine("/sys/devices/system/node/online"))) {
+            Node node;
+            node.id = id;
+            node.cpus = parseList(
+                readLine("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist"));
+            // Memory-only nodes cannot run threads
+            if (!node.cpus.empty()) {
+                nodes_.push_back(std::move(node));
+            }
+        }
+    } catch (const std::exception &) {
+        nodes_.clear();
+    }
+#elif defined(_WIN32)
+    ULONG highest = 0;
+    if (GetNumaHighestNodeNumber(&highest)) {
+        for (USHORT id = 0; id <= highest; ++id) {
+            GROUP_AFFINITY affinity{};
+            if (!GetNumaNodeProcessorMaskEx(id, &affinity) || affinity.Mask == 0) {
+                continue;
+            }
+            Node node;
+            node.id = id;
+            node.group = affinity.Group;
+            for (std::uint32_t cpu = 0; cpu < sizeof(KAFFINITY) * 8; ++cpu) {
+                if (affinity.Mask & (KAFFINITY{1} << cpu)) {
+                    node.cpus.push_back(cpu);
+                }
+            }
+            nodes_.push_back(std::move(node));
+        }
+    }
+#endif
+    if (nodes_.empty()) {
+        nodes_.emplace_back();
+    }
+
+    if (const char *fake = std::getenv("FAST_MRMR_NUMA_NODES")) {
+        unsigned long nodes = std::strtoul(fake, nullptr, 10);
+        if (nodes > 0) {
+            split(static_cast<std::uint32_t>(std::min<unsigned long>(nodes, UINT32_MAX)));
+        }
+    }
+}
+
+// Replaces the nodes by the given number of fake ones sharing out the same processors. With
+// more nodes than processors, consecutive nodes share a processor.
+void NumaTopology::split(std::uint32_t nodes)
+{
+    std::vector<Node> cpus;
+    for (const Node &node : nodes_) {
+        for (std::uint32_t cpu : node.cpus) {
+            cpus.push_back({node.id, node.group, {cpu}});
+        }
+    }
+    std::vector<Node> fake(nodes);
+    for (std::uint32_t k = 0; k < nodes && !cpus.empty(); ++k) {
+        const std::size_t first = cpus.size() * k / nodes;
+        const std::size_t last = std::max(cpus.size() * (k + 1) / nodes, first + 1);
+        fake[k].id = cpus[first].id;
+        fake[k].group = cpus[first].group;
+        for (std::size_t c = first; c < last; ++c) {
+            // Affinity can only be set within one processor group
+            if (cpus[c].group == fake[k].group) {
+                fake[k].cpus.push_back(cpus[c].cpus[0]);
+            }
+        }
+    }
+    nodes_ = std::move(fake);
+}
+
+std::uint32_t NumaTopology::nodes() const
+{
+    return static_cast<std::uint32_t>(nodes_.size());
+}
+
+const NumaTopology::Node &NumaTopology::node(std::uint32_t index) const
+{
+    if (index >= nodes_.size()) {
+        throw std::out_of_range("NUMA node out of range");
+    }
+    return nodes_[index];
+}
+
+/**
+ * Restricts the calling thread to the processors of a node.
+ *
+ * @return Whether the affinity could be set
+ */
+bool pinCurrentThread(std::uint32_t node)
+{
+    const NumaTopology::Node &info = NumaTopology::instance().node(node);
+    if (info.cpus.empty()) {
+        return false;
+    }
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (std::uint32_t cpu : info.cpus) {
+        if (cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+    GROUP_AFFINITY affinity{};
+    affinity.Group = info.group;
+    for (std::uint32_t cpu : info.cpus) {
+        affinity.Mask |= KAFFINITY{1} << cpu;
+    }
+    return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Allocates page-aligned memory whose pages are preferably placed on the given node, whichever
+ * thread touches them first. Falls back to normal placement where the policy is unavailable.
+ * Release it with freeOnNode().
+ */
+void *allocateOnNode(std::size_t bytes, std::uint32_t node)
+{
+    if (bytes == 0) {
+        return nullptr;
+    }
+    const std::uint32_t id = NumaTopology::instance().node(node).id;
+#ifdef _WIN32
+    void *memory = VirtualAllocExNuma(
+        GetCurrentProcess(), nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, id);
+    if (memory == nullptr) {
+        memory = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+#else
+    void *memory =
+        mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+#ifdef __linux__
+    if (id < kMaxNodes) {
+        constexpr std::size_t bits = 8 * sizeof(unsigned long);
+        unsigned long mask[kMaxNodes / bits] = {};
+        mask[id / bits] = 1ul << (id % bits);
+        // Best effort: without the policy the pages still follow the first touch
+        syscall(SYS_mbind, memory, bytes, kPolicyPreferred, mask, kMaxNodes + 1, 0);
+    }
+#else
+    (void)id;
+#endif
+    return memory;
+#endif
+}
+
+void freeOnNode(void *memory, std::size_t bytes)
+{
+    if (memory == nullptr) {
+        return;
+    }
+#ifdef _WIN32
+    (void)bytes;
+    VirtualFree(memory, 0, MEM_RELEASE);
+#else
+    munmap(memory, bytes);
+#endif
+}
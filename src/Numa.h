@@ -0,0 +1,57 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// NUMA nodes of the machine and the processors on each, detected once from
+// /sys/devices/system/node on Linux and the NUMA API on Windows. Machines or platforms without
+// NUMA information report a single node with no processor list.
+//
+// Setting FAST_MRMR_NUMA_NODES=<n> replaces the detected topology by n nodes, each with a
+// consecutive share of the processors, so that placement can be tested and benchmarked on a
+// single-node machine. The memory of a fake node goes to the real node of its first processor.
+class NumaTopology
+{
+  public:
+    struct Node {
+        // Node number used by the operating system.
+        std::uint32_t id = 0;
+        // Processor group (Windows only) and processor numbers within it.
+        std::uint16_t group = 0;
+        std::vector<std::uint32_t> cpus;
+    };
+
+    static const NumaTopology &instance();
+
+    std::uint32_t nodes() const;
+    const Node &node(std::uint32_t index) const;
+
+  private:
+    NumaTopology();
+    void split(std::uint32_t nodes);
+
+    std::vector<Node> nodes_;
+};
+
+bool pinCurrentThread(std::uint32_t node);
+
+void *allocateOnNode(std::size_t bytes, std::uint32_t node);
+void freeOnNode(void *memory, std::size_t bytes);
@@ -0,0 +1,130 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Parallel.h"
+
+#include "Numa.h"
+
+namespace
+{
+thread_local bool in_pool_job = false;
+thread_local std::uint32_t current_node = ThreadPool::kNoNode;
+}
+
+ThreadPool &ThreadPool::instance()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread &thread : threads_) {
+        thread.join();
+    }
+}
+
+void ThreadPool::run(std::size_t workers, const std::function<void()> &work)
+{
+    if (workers <= 1 || in_pool_job) {
+        work();
+        return;
+    }
+
+    std::lock_guard<std::mutex> run_lock(run_mutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // The pool only grows; threads are started the first time they are needed.
+        while (threads_.size() < workers - 1) {
+            threads_.emplace_back(&ThreadPool::workerLoop, this, threads_.size(), generation_);
+        }
+        job_ = &work;
+        participants_ = workers - 1;
+        pending_ = workers - 1;
+        generation_++;
+    }
+    wake_.notify_all();
+
+    in_pool_job = true;
+    work();
+    in_pool_job = false;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return pending_ == 0; });
+    job_ = nullptr;
+}
+
+std::uint32_t ThreadPool::enableNumaPlacement()
+{
+    nodes_.store(NumaTopology::instance().nodes());
+    return nodes_.load();
+}
+
+// Number of nodes the pool threads are spread over.
+std::uint32_t ThreadPool::nodes() const
+{
+    return nodes_.load();
+}
+
+// NUMA node the calling thread was pinned to; kNoNode for threads outside the pool.
+std::uint32_t ThreadPool::currentNode()
+{
+    return current_node;
+}
+
+// Waits for each new job generation and takes part in it when its id is low enough.
+void ThreadPool::workerLoop(std::size_t id, std::uint64_t seen)
+{
+    in_pool_job = true;
+    bool pinned = false;
+
+    while (true) {
+        const std::function<void()> *job = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+            if (stop_) {
+                return;
+            }
+            seen = generation_;
+            if (id >= participants_) {
+                continue;
+            }
+            job = job_;
+        }
+
+        // Pinned lazily, on the first job after NUMA placement is enabled
+        std::uint32_t nodes = nodes_.load();
+        if (nodes > 1 && !pinned) {
+            current_node = static_cast<std::uint32_t>(id % nodes);
+            pinCurrentThread(current_node);
+            pinned = true;
+        }
+
+        (*job)();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--pending_ == 0) {
+            done_.notify_one();
+        }
+    }
+}
@@ -0,0 +1,178 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Number of worker threads used when none is requested explicitly.
+inline std::uint32_t defaultThreads()
+{
+    unsigned int threads = std::thread::hardware_concurrency();
+    return threads == 0 ? 1 : threads;
+}
+
+// Process-wide set of persistent worker threads. Workers live for the whole run, so anything
+// they keep in thread_local storage (their Workspace in particular) is reused across calls.
+class ThreadPool
+{
+  public:
+    // currentNode() of threads that are not pinned to a node.
+    static constexpr std::uint32_t kNoNode = UINT32_MAX;
+
+    static ThreadPool &instance();
+
+    // Runs work on the calling thread and on workers - 1 pool threads, and returns once all of
+    // them are done. Calls made from inside a pool job run work on the calling thread only.
+    void run(std::size_t workers, const std::function<void()> &work);
+
+    // Pins pool thread i to NUMA node i % nodes from its next job on. The calling thread is not
+    // pinned and has no home node. Returns the number of nodes, 1 when there is nothing to
+    // spread over.
+    std::uint32_t enableNumaPlacement();
+    std::uint32_t nodes() const;
+    static std::uint32_t currentNode();
+
+    ~ThreadPool();
+
+  private:
+    ThreadPool() = default;
+    void workerLoop(std::size_t id, std::uint64_t seen);
+
+    std::mutex run_mutex_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    std::vector<std::thread> threads_;
+    const std::function<void()> *job_ = nullptr;
+    std::uint64_t generation_ = 0;
+    std::size_t participants_ = 0;
+    std::size_t pending_ = 0;
+    bool stop_ = false;
+    std::atomic<std::uint32_t> nodes_{1};
+};
+
+// Runs fn(i) for every i in [0, count) on up to threads threads, the calling thread included.
+// Indices are handed out in chunks from a shared counter, so uneven work balances itself.
+// The first exception thrown by fn is rethrown once every thread has stopped.
+template <typename Function>
+void parallelFor(std::size_t count, std::uint32_t threads, Function &&fn, std::size_t chunk = 1)
+{
+    std::size_t workers =
+        std::min<std::size_t>(std::max<std::uint32_t>(threads, 1), (count + chunk - 1) / chunk);
+
+    if (workers <= 1) {
+        for (std::size_t i = 0; i < count; ++i) {
+            fn(i);
+        }
+        return;
+    }
+
+    std::atomic<std::size_t> next{0};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    std::function<void()> work = [&]() {
+        try {
+            for (std::size_t begin = next.fetch_add(chunk); begin < count;
+                 begin = next.fetch_add(chunk)) {
+                std::size_t end = std::min(begin + chunk, count);
+                for (std::size_t i = begin; i < end; ++i) {
+                    fn(i);
+                }
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+            next.store(count);
+        }
+    };
+
+    ThreadPool::instance().run(workers, work);
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+// Like parallelFor, but fn(i) preferably runs on a thread of NUMA node node_of(i). Each pinned
+// thread first drains the items of its own node and then helps with the others, so a node with
+// more work does not hold up the loop; threads without a home node, such as the caller, take
+// from whichever node has the most items left. Without NUMA placement this is parallelFor.
+template <typename NodeOf, typename Function>
+void parallelForPlaced(std::size_t count, std::uint32_t threads, NodeOf &&node_of, Function &&fn)
+{
+    const std::uint32_t nodes = ThreadPool::instance().nodes();
+    if (nodes <= 1) {
+        parallelFor(count, threads, std::forward<Function>(fn));
+        return;
+    }
+
+    std::vector<std::vector<std::size_t>> items(nodes);
+    for (std::size_t i = 0; i < count; ++i) {
+        items[static_cast<std::uint32_t>(node_of(i)) % nodes].push_back(i);
+    }
+    std::vector<std::atomic<std::size_t>> next(nodes);
+
+    parallelFor(std::min<std::size_t>(std::max<std::uint32_t>(threads, 1), count),
+                threads,
+                [&](std::size_t) {
+                    if (ThreadPool::currentNode() == ThreadPool::kNoNode) {
+                        while (true) {
+                            std::uint32_t busiest = 0;
+                            std::size_t most = 0;
+                            for (std::uint32_t k = 0; k < nodes; ++k) {
+                                std::size_t taken = next[k].load();
+                                std::size_t left =
+                                    taken < items[k].size() ? items[k].size() - taken : 0;
+                                if (left > most) {
+                                    busiest = k;
+                                    most = left;
+                                }
+                            }
+                            if (most == 0) {
+                                return;
+                            }
+                            std::size_t i = next[busiest].fetch_add(1);
+                            if (i < items[busiest].size()) {
+                                fn(items[busiest][i]);
+                            }
+                        }
+                    }
+
+                    const std::uint32_t home = ThreadPool::currentNode() % nodes;
+                    for (std::uint32_t k = 0; k < nodes; ++k) {
+                        const std::vector<std::size_t> &node_items = items[(home + k) % nodes];
+                        std::atomic<std::size_t> &cursor = next[(home + k) % nodes];
+                        for (std::size_t i = cursor.fetch_add(1); i < node_items.size();
+                             i = cursor.fetch_add(1)) {
+                            fn(node_items[i]);
+                        }
+                    }
+                });
+}
@@ -19,7 +19,7 @@
 
 #include <stdexcept>
 
-#include "Histogram.h"
+#include "RawData.h"
 
 ProbTable::ProbTable(RawData& rd)
     : raw_data_(rd)
@@ -35,22 +35,20 @@ ProbTable::ProbTable(RawData& rd)
     calculate();
 }
 
-// Calculates the marginal probability table for each possible value in a feature.
-// This table is cached in memory to avoid repeating calculations.
+// Calculates the marginal probability table for each possible value in a feature from the
+// value counts RawData gathered while loading. This table is cached in memory to avoid
+// repeating calculations.
 void ProbTable::calculate()
 {
-    Histogram histogram(raw_data_);
-
     for (std::uint32_t i = 0; i < features_size_; ++i) {
-        // Get histogram for this feature
-        std::vector<std::uint32_t> hist_data = histogram.getHistogram(i);
+        const std::vector<std::uint64_t>& counts = raw_data_.getValueCounts(i);
 
         // Resize the inner vector for this feature
         table_[i].resize(values_range_[i]);
 
         // Calculate and store probabilities
         for (std::uint32_t j = 0; j < values_range_[i]; ++j) {
-            table_[i][j] = static_cast<double>(hist_data[j]) / static_cast<double>(data_size_);
+            table_[i][j] = static_cast<double>(counts[j]) / static_cast<double>(data_size_);
         }
     }
 }
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <vector>
 
 class RawData;
@@ -36,5 +37,5 @@ class ProbTable
 
     std::vector<std::uint32_t> values_range_;
     std::uint32_t features_size_;
-    std::uint32_t data_size_;
+    std::uint64_t data_size_;
 };
\ No newline at end of file
@@ -17,14 +17,45 @@
 
 #include "RawData.h"
 
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <limits>
 #include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#include "Hash.h"
+#include "Numa.h"
+#include "Parallel.h"
+#include "Stats.h"
+#include "Transpose.h"
+
+namespace
+{
+// Bytes of row-major samples read per block while loading.
+constexpr std::size_t kLoadBlockBytes = std::size_t{32} << 20;
+// Rows per block are rounded to whole transpose tiles.
+constexpr std::size_t kTransposeTile = 16;
+// Columns transposed by one task; a multiple of the tile size.
+constexpr std::size_t kLoadBandColumns = 64;
+}  // namespace
 
 /**
  * Constructor that creates a rawData object.
  *
  * @param filename Path to the data_ file
+ * @param options Storage options applied while loading
  */
-RawData::RawData(const std::string &filename)
+RawData::RawData(const std::string &filename, const LoadOptions &options)
+    : options_(options),
+      borrowed_(false),
+      sparse_features_size_(0),
+      data_offset_(0),
+      constant_features_size_(0),
+      duplicate_features_size_(0),
+      content_hash_(0)
 {
     // Open file with binary mode
     data_file_.open(filename, std::ios::binary);
@@ -32,77 +63,522 @@ RawData::RawData(const std::string &filename)
         throw std::runtime_error("Could not open file: " + filename);
     }
 
+    if (isColumnarFile(data_file_)) {
+        ColumnarHeader header = readColumnarHeader(data_file_);
+        data_size_ = header.data_size;
+        features_size_ = header.features_size;
+        {
+            ScopedPhase phase("load/decompress");
+            loadColumnar(header);
+        }
+        {
+            ScopedPhase phase("load/value_ranges");
+            calculateVR();
+            for (std::uint32_t i = 0; i < features_size_; i++) {
+                if (values_range_[i] > header.values_range[i]) {
+                    throw std::runtime_error("Value out of the declared range in: " + filename);
+                }
+            }
+            findRedundantColumns();
+            compactSparse();
+        }
+        if (options_.numa) {
+            ScopedPhase phase("load/numa_placement");
+            placeColumns();
+        }
+        return;
+    }
+
     calculateDSandFS();
-    loadData();
-    calculateVR();
+    {
+        ScopedPhase phase("load/transpose");
+        loadData();
+    }
+    analyzeColumns();
+}
+
+/**
+ * Constructor over samples already in memory, laid out row by row like a .mrmr file. They are
+ * transposed into a column-major copy owned by this object.
+ *
+ * @param rows features_size values per sample, sample after sample
+ * @param features_size Number of features
+ * @param options Storage options applied while loading
+ */
+RawData::RawData(std::span<const std::uint8_t> rows,
+                 std::uint32_t features_size,
+                 const LoadOptions &options)
+    : options_(options),
+      borrowed_(false),
+      sparse_features_size_(0),
+      features_size_(features_size),
+      data_size_(0),
+      data_offset_(0),
+      constant_features_size_(0),
+      duplicate_features_size_(0),
+      content_hash_(0)
+{
+    if (features_size_ == 0 ? !rows.empty() : rows.size() % features_size_ != 0) {
+        throw std::invalid_argument("Rows must hold a whole number of samples");
+    }
+    data_size_ = features_size_ == 0 ? 0 : rows.size() / features_size_;
+    {
+        ScopedPhase phase("load/transpose");
+        data_.resize(rows.size());
+        bindColumns();
+        transposeRows(rows.data(), data_size_, 0);
+        Stats::instance().add(Stats::Counter::BytesLoaded, data_.size());
+    }
+    analyzeColumns();
+}
+
+/**
+ * Constructor over column-major data owned by the caller. Dense columns are used in place, so
+ * they must outlive this object; only columns stored sparse or placed on NUMA nodes are copied.
+ *
+ * @param columns One pointer per feature to data_size contiguous values
+ * @param data_size Number of samples
+ * @param options Storage options applied while loading
+ */
+RawData::RawData(std::vector<const std::uint8_t *> columns,
+                 std::uint64_t data_size,
+                 const LoadOptions &options)
+    : options_(options),
+      columns_(std::move(columns)),
+      borrowed_(true),
+      sparse_features_size_(0),
+      features_size_(static_cast<std::uint32_t>(columns_.size())),
+      data_size_(data_size),
+      data_offset_(0),
+      constant_features_size_(0),
+      duplicate_features_size_(0),
+      content_hash_(0)
+{
+    if (columns_.size() > UINT32_MAX) {
+        throw std::invalid_argument("Too many features");
+    }
+    if (data_size_ > 0
+        && std::find(columns_.begin(), columns_.end(), nullptr) != columns_.end()) {
+        throw std::invalid_argument("Column pointers must not be null");
+    }
+    analyzeColumns();
 }
 
 RawData::~RawData()
 {
+    for (auto &[buffer, bytes] : node_buffers_) {
+        freeOnNode(buffer, bytes);
+    }
     if (data_file_.is_open()) {
         data_file_.close();
     }
 }
 
+/**
+ * Finds the constant features and the features identical to an earlier one. Features are
+ * grouped by hash, and only features with equal hashes are compared byte by byte, so this is
+ * cheap unless the data holds many duplicates.
+ */
+void RawData::findRedundantColumns()
+{
+    aliases_.resize(features_size_);
+    constant_features_size_ = 0;
+    duplicate_features_size_ = 0;
+
+    std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> by_hash;
+    for (std::uint32_t i = 0; i < features_size_; i++) {
+        aliases_[i] = i;
+        std::vector<std::uint32_t> &originals = by_hash[feature_hashes_[i]];
+        for (std::uint32_t original : originals) {
+            if (value_counts_[original] == value_counts_[i]
+                && std::memcmp(columns_[original], columns_[i], data_size_) == 0) {
+                aliases_[i] = original;
+                break;
+            }
+        }
+        if (aliases_[i] == i) {
+            originals.push_back(i);
+        }
+
+        if (isConstant(i)) {
+            constant_features_size_++;
+        } else if (aliases_[i] != i) {
+            duplicate_features_size_++;
+        }
+    }
+}
+
 /**
  * Calculates DataSize: Number of patterns or samples
  * FeaturesSize: Number of features
+ * from either the original 32-bit header or the wide 64-bit one.
  */
 void RawData::calculateDSandFS()
 {
-    std::uint32_t data_size_buffer = 0;
-    std::uint32_t features_size_buffer = 0;
+    RowMajorHeader header = readRowMajorHeader(data_file_);
+    data_size_ = header.data_size;
+    features_size_ = header.features_size;
+    data_offset_ = header.data_offset;
+}
+
+/**
+ * Reads the row-major samples in large blocks and transposes them into the column-major data_.
+ * The next block is read in the background while the current one is transposed.
+ */
+void RawData::loadData()
+{
+    const std::size_t row_bytes = features_size_;
+
+    // Preallocate with the right size
+    data_.resize(row_bytes * data_size_);
+    bindColumns();
+    if (data_.empty()) {
+        return;
+    }
+
+    // Seek to position after header
+    data_file_.seekg(static_cast<std::streamoff>(data_offset_));
 
-    if (!data_file_.read(reinterpret_cast<char *>(&data_size_buffer), sizeof(std::uint32_t))
-        || !data_file_.read(reinterpret_cast<char *>(&features_size_buffer),
-                            sizeof(std::uint32_t))) {
-        throw std::runtime_error("Failed to read data dimensions from file");
+    // Whole tiles of rows per block, at least one tile
+    const std::size_t block_rows = std::max<std::size_t>(
+        kTransposeTile, kLoadBlockBytes / row_bytes / kTransposeTile * kTransposeTile);
+    std::vector<std::uint8_t> current(std::min<std::uint64_t>(block_rows, data_size_) * row_bytes);
+    std::vector<std::uint8_t> next(current.size());
+
+    auto read_block = [this, row_bytes](std::vector<std::uint8_t> &buffer, std::size_t rows) {
+        return static_cast<bool>(data_file_.read(reinterpret_cast<char *>(buffer.data()),
+                                                 static_cast<std::streamsize>(rows * row_bytes)));
+    };
+
+    if (!read_block(current, std::min<std::uint64_t>(block_rows, data_size_))) {
+        throw std::runtime_error("Failed to read data_ from file");
     }
 
-    data_size_ = data_size_buffer;
-    features_size_ = features_size_buffer;
+    for (std::size_t row = 0; row < data_size_;) {
+        const std::size_t rows = std::min<std::uint64_t>(block_rows, data_size_ - row);
+        const std::size_t next_rows = std::min<std::uint64_t>(block_rows, data_size_ - row - rows);
+
+        std::future<bool> prefetch;
+        if (next_rows > 0) {
+            prefetch = std::async(std::launch::async, read_block, std::ref(next), next_rows);
+        }
+
+        transposeRows(current.data(), rows, row);
+
+        if (prefetch.valid() && !prefetch.get()) {
+            throw std::runtime_error("Failed to read data_ from file");
+        }
+        std::swap(current, next);
+        row += rows;
+    }
+
+    Stats::instance().add(Stats::Counter::BytesLoaded, data_.size());
 }
 
-void RawData::loadData()
+/**
+ * Transposes count row-major samples into data_, starting at sample first_row. All threads
+ * take part, each owning a band of columns so their writes never share cache lines.
+ */
+void RawData::transposeRows(const std::uint8_t *rows, std::size_t count, std::uint64_t first_row)
 {
-    std::uint8_t buffer;
+    const std::size_t row_bytes = features_size_;
+    const std::uint32_t threads = options_.threads == 0 ? defaultThreads() : options_.threads;
+    const std::size_t column_bands = (row_bytes + kLoadBandColumns - 1) / kLoadBandColumns;
+    parallelFor(column_bands, threads, [&](std::size_t band) {
+        std::size_t begin = band * kLoadBandColumns;
+        std::size_t end = std::min(begin + kLoadBandColumns, row_bytes);
+        transposeBlock(rows, count, row_bytes, begin, end, data_.data() + first_row, data_size_);
+    });
+}
 
-    // Preallocate with the right size
-    data_.resize(features_size_ * data_size_);
+// Points every column into data_, which holds features_size_ columns of data_size_ values.
+void RawData::bindColumns()
+{
+    columns_.resize(features_size_);
+    for (std::uint32_t i = 0; i < features_size_; i++) {
+        columns_[i] = data_.data() + static_cast<std::size_t>(i) * data_size_;
+    }
+}
+
+// Everything derived from the values once every column is in place.
+void RawData::analyzeColumns()
+{
+    {
+        ScopedPhase phase("load/value_ranges");
+        calculateVR();
+        findRedundantColumns();
+        compactSparse();
+    }
+    if (options_.numa) {
+        ScopedPhase phase("load/numa_placement");
+        placeColumns();
+    }
+}
+
+/**
+ * Loads a version 2 (columnar, block-compressed) file. Consecutive features are read in
+ * batches of roughly kLoadBlockBytes of compressed data; while the next batch is read in the
+ * background, the blocks of the current one are decompressed in parallel straight into data_.
+ */
+void RawData::loadColumnar(const ColumnarHeader &header)
+{
+    const std::uint32_t threads = options_.threads == 0 ? defaultThreads() : options_.threads;
+    const std::uint64_t blocks_per_feature = header.blocksPerFeature();
+    const std::uint64_t payload_start = header.headerSize();
+
+    data_.resize(static_cast<std::size_t>(features_size_) * data_size_);
+    bindColumns();
+    if (data_.empty()) {
+        return;
+    }
+
+    struct Batch {
+        std::uint32_t first;
+        std::uint32_t last;
+        std::uint64_t begin;
+        std::uint64_t end;
+    };
+
+    // Group features so that each batch spans about kLoadBlockBytes of payload
+    std::vector<Batch> batches;
+    for (std::uint32_t feature = 0; feature < features_size_; feature++) {
+        std::uint64_t begin = UINT64_MAX;
+        std::uint64_t end = 0;
+        for (std::uint64_t b = 0; b < blocks_per_feature; b++) {
+            const BlockInfo &block = header.block(feature, b);
+            begin = std::min(begin, block.offset);
+            end = std::max(end, block.offset + block.size);
+        }
+        if (batches.empty() || batches.back().end - batches.back().begin >= kLoadBlockBytes) {
+            batches.push_back({feature, feature + 1, begin, end});
+        } else {
+            Batch &batch = batches.back();
+            batch.last = feature + 1;
+            batch.begin = std::min(batch.begin, begin);
+            batch.end = std::max(batch.end, end);
+        }
+    }
+
+    auto read_batch = [this, payload_start](std::vector<std::uint8_t> &buffer, const Batch &batch) {
+        buffer.resize(batch.end - batch.begin);
+        data_file_.seekg(static_cast<std::streamoff>(payload_start + batch.begin));
+        return static_cast<bool>(data_file_.read(reinterpret_cast<char *>(buffer.data()),
+                                                 static_cast<std::streamsize>(buffer.size())));
+    };
 
-    // Seek to position after header (8 bytes)
-    data_file_.seekg(8);
+    std::vector<std::uint8_t> current;
+    std::vector<std::uint8_t> next;
+    if (!read_batch(current, batches.front())) {
+        throw std::runtime_error("Failed to read data_ from file");
+    }
+
+    for (std::size_t k = 0; k < batches.size(); k++) {
+        const Batch &batch = batches[k];
+
+        std::future<bool> prefetch;
+        if (k + 1 < batches.size()) {
+            prefetch = std::async(
+                std::launch::async, read_batch, std::ref(next), std::cref(batches[k + 1]));
+        }
 
-    for (std::uint32_t i = 0; i < data_size_; i++) {
-        for (std::uint32_t j = 0; j < features_size_; j++) {
-            if (!data_file_.read(reinterpret_cast<char *>(&buffer), sizeof(std::uint8_t))) {
-                throw std::runtime_error("Failed to read data_ from file");
+        const std::size_t tasks = (batch.last - batch.first) * blocks_per_feature;
+        parallelFor(tasks, threads, [&](std::size_t task) {
+            std::uint32_t feature =
+                batch.first + static_cast<std::uint32_t>(task / blocks_per_feature);
+            std::uint64_t b = task % blocks_per_feature;
+            const BlockInfo &block = header.block(feature, b);
+            std::uint64_t row = b * header.block_rows;
+            std::uint64_t count = std::min<std::uint64_t>(header.block_rows, data_size_ - row);
+            if (block.offset < batch.begin || block.offset + block.size > batch.end) {
+                throw std::runtime_error("Corrupt block index in columnar file");
             }
-            data_[j * data_size_ + i] = buffer;
+            decodeBlock(block.codec,
+                        current.data() + (block.offset - batch.begin),
+                        block.size,
+                        header.values_range[feature],
+                        data_.data() + static_cast<std::size_t>(feature) * data_size_ + row,
+                        count);
+        });
+
+        if (prefetch.valid() && !prefetch.get()) {
+            throw std::runtime_error("Failed to read data_ from file");
         }
+        std::swap(current, next);
     }
+
+    Stats::instance().add(Stats::Counter::BytesLoaded, data_.size());
 }
 
 /**
- * Calculates how many different values each feature has.
+ * Calculates how many different values each feature has, i.e. its maximum value plus one,
+ * together with the number of rows holding each value and a hash of the feature contents.
  */
 void RawData::calculateVR()
 {
     values_range_.resize(features_size_, 0);
+    value_counts_.resize(features_size_);
+    feature_hashes_.resize(features_size_);
+
+    const std::uint32_t threads = options_.threads == 0 ? defaultThreads() : options_.threads;
+    parallelFor(features_size_, threads, [this](std::size_t i) {
+        const std::uint8_t *column = columns_[i];
+        std::vector<std::uint64_t> counts(256, 0);
+
+        // The feature is hashed a word at a time in the same pass
+        std::uint64_t hash = hashMix(data_size_);
+        std::size_t j = 0;
+        for (; j + 8 <= data_size_; j += 8) {
+            std::uint64_t word;
+            std::memcpy(&word, column + j, sizeof(word));
+            hash = hashMix(hash ^ word);
+            for (std::size_t k = 0; k < 8; k++) {
+                counts[column[j + k]]++;
+            }
+        }
+        std::uint64_t tail = 0;
+        for (; j < data_size_; j++) {
+            counts[column[j]]++;
+            tail = (tail << 8) | column[j];
+        }
+        feature_hashes_[i] = hashMix(hash ^ tail);
 
-    for (std::uint32_t i = 0; i < features_size_; i++) {
         std::uint32_t vr = 0;
-        for (std::uint32_t j = 0; j < data_size_; j++) {
-            std::uint8_t dataRead = data_[i * data_size_ + j];
-            if (dataRead > vr) {
-                vr++;
+        for (std::uint32_t v = 0; v < counts.size(); v++) {
+            if (counts[v] > 0) {
+                vr = v;
             }
         }
         values_range_[i] = vr + 1;
+        counts.resize(values_range_[i]);
+        value_counts_[i] = std::move(counts);
+    });
+
+    content_hash_ = hashCombine(data_size_, features_size_);
+    for (std::uint64_t hash : feature_hashes_) {
+        content_hash_ = hashCombine(content_hash_, hash);
     }
 }
 
-std::uint32_t RawData::getDataSize() const
+/**
+ * Moves the columns with enough zeros to the sparse representation and packs the remaining
+ * dense columns at the front of data_, releasing the space they leave. Borrowed dense columns
+ * stay where they are.
+ */
+void RawData::compactSparse()
+{
+    std::vector<bool> sparse(features_size_, false);
+    sparse_columns_.resize(features_size_);
+
+    std::uint32_t slot = 0;
+    for (std::uint32_t i = 0; i < features_size_; i++) {
+        const std::uint8_t *column = columns_[i];
+        double zeros = static_cast<double>(value_counts_[i][0]);
+
+        if (data_size_ > 0 && data_size_ <= std::numeric_limits<SparseColumn::Row>::max()
+            && zeros >= options_.sparse_threshold * static_cast<double>(data_size_)) {
+            SparseColumn &sparse_column = sparse_columns_[i];
+            sparse_column.rows.reserve(data_size_ - value_counts_[i][0]);
+            sparse_column.values.reserve(data_size_ - value_counts_[i][0]);
+            for (std::size_t j = 0; j < data_size_; j++) {
+                if (column[j] != 0) {
+                    sparse_column.rows.push_back(static_cast<SparseColumn::Row>(j));
+                    sparse_column.values.push_back(column[j]);
+                }
+            }
+            sparse[i] = true;
+            sparse_features_size_++;
+            continue;
+        }
+
+        if (!borrowed_ && slot != i) {
+            std::copy(column,
+                      column + data_size_,
+                      data_.begin() + static_cast<std::ptrdiff_t>(slot) * data_size_);
+        }
+        slot++;
+    }
+
+    column_nodes_.assign(features_size_, 0);
+    if (borrowed_) {
+        for (std::uint32_t i = 0; i < features_size_; i++) {
+            if (sparse[i]) {
+                columns_[i] = nullptr;
+            }
+        }
+        return;
+    }
+
+    if (sparse_features_size_ > 0) {
+        data_.resize(static_cast<std::size_t>(slot) * data_size_);
+        data_.shrink_to_fit();
+    }
+
+    // Pointers are only taken once data_ has its final size.
+    columns_.assign(features_size_, nullptr);
+    slot = 0;
+    for (std::uint32_t i = 0; i < features_size_; i++) {
+        if (!sparse[i]) {
+            columns_[i] = data_.data() + static_cast<std::size_t>(slot++) * data_size_;
+        }
+    }
+}
+
+/**
+ * Moves the dense columns to one buffer per NUMA node, in contiguous runs of features, so that
+ * work on a feature can be scheduled next to its memory. The copy is done by threads of the
+ * receiving node, and data_ is released afterwards.
+ */
+void RawData::placeColumns()
+{
+    const std::uint32_t nodes = NumaTopology::instance().nodes();
+    const std::uint32_t dense = features_size_ - sparse_features_size_;
+    if (nodes <= 1 || dense == 0 || data_size_ == 0) {
+        return;
+    }
+
+    std::vector<std::uint32_t> dense_features;
+    for (std::uint32_t i = 0; i < features_size_; i++) {
+        if (columns_[i] != nullptr) {
+            column_nodes_[i] =
+                static_cast<std::uint32_t>(std::uint64_t{dense_features.size()} * nodes / dense);
+            dense_features.push_back(i);
+        }
+    }
+
+    std::vector<std::uint8_t *> next(nodes, nullptr);
+    for (std::uint32_t node = 0; node < nodes; node++) {
+        std::size_t node_columns = static_cast<std::size_t>(
+            std::count_if(dense_features.begin(), dense_features.end(), [&](std::uint32_t i) {
+                return column_nodes_[i] == node;
+            }));
+        std::size_t bytes = node_columns * data_size_;
+        void *buffer = allocateOnNode(bytes, node);
+        node_buffers_.emplace_back(buffer, bytes);
+        next[node] = static_cast<std::uint8_t *>(buffer);
+    }
+
+    std::vector<std::uint8_t *> placed(features_size_, nullptr);
+    for (std::uint32_t i : dense_features) {
+        placed[i] = next[column_nodes_[i]];
+        next[column_nodes_[i]] += data_size_;
+    }
+
+    const std::uint32_t threads = options_.threads == 0 ? defaultThreads() : options_.threads;
+    parallelForPlaced(
+        dense_features.size(),
+        threads,
+        [&](std::size_t k) { return column_nodes_[dense_features[k]]; },
+        [&](std::size_t k) {
+            std::uint32_t i = dense_features[k];
+            std::memcpy(placed[i], columns_[i], data_size_);
+        });
+
+    columns_.assign(placed.begin(), placed.end());
+    data_.clear();
+    data_.shrink_to_fit();
+}
+
+std::uint64_t RawData::getDataSize() const
 {
     return data_size_;
 }
@@ -131,6 +607,122 @@ const std::vector<std::uint32_t> &RawData::getValuesRangeArray() const
     return values_range_;
 }
 
+/**
+ * Returns how many rows hold each value of a feature, indexed by value.
+ */
+const std::vector<std::uint64_t> &RawData::getValueCounts(std::uint32_t index) const
+{
+    if (index >= value_counts_.size()) {
+        throw std::out_of_range("Feature index out of range");
+    }
+    return value_counts_[index];
+}
+
+/**
+ * Returns a hash of the values of a feature. Equal features have equal hashes.
+ */
+std::uint64_t RawData::getFeatureHash(std::uint32_t index) const
+{
+    if (index >= feature_hashes_.size()) {
+        throw std::out_of_range("Feature index out of range");
+    }
+    return feature_hashes_[index];
+}
+
+/**
+ * Returns a hash of the dimensions and all values of the dataset, independent of the file
+ * format it was loaded from.
+ */
+std::uint64_t RawData::getContentHash() const
+{
+    return content_hash_;
+}
+
+std::uint32_t RawData::getSparseFeaturesSize() const
+{
+    return sparse_features_size_;
+}
+
+/**
+ * Number of features holding a single value, which carry no information.
+ */
+std::uint32_t RawData::getConstantFeaturesSize() const
+{
+    return constant_features_size_;
+}
+
+/**
+ * Number of non-constant features identical to an earlier feature.
+ */
+std::uint32_t RawData::getDuplicateFeaturesSize() const
+{
+    return duplicate_features_size_;
+}
+
+bool RawData::isConstant(std::uint32_t index) const
+{
+    if (index >= value_counts_.size()) {
+        throw std::out_of_range("Feature index out of range");
+    }
+    const std::vector<std::uint64_t> &counts = value_counts_[index];
+    return std::count_if(counts.begin(), counts.end(), [](std::uint64_t count) {
+               return count > 0;
+           }) <= 1;
+}
+
+/**
+ * Returns the first feature with exactly the same values as a feature, or the feature itself
+ * if no earlier one matches.
+ */
+std::uint32_t RawData::getAlias(std::uint32_t index) const
+{
+    if (index >= aliases_.size()) {
+        throw std::out_of_range("Feature index out of range");
+    }
+    return aliases_[index];
+}
+
+bool RawData::isSparse(std::uint32_t index) const
+{
+    if (index >= features_size_) {
+        throw std::out_of_range("Feature index out of range");
+    }
+    return columns_[index] == nullptr;
+}
+
+/**
+ * Returns the NUMA node holding a feature; 0 unless the columns were placed across nodes.
+ */
+std::uint32_t RawData::getColumnNode(std::uint32_t index) const
+{
+    if (index >= features_size_) {
+        throw std::out_of_range("Feature index out of range");
+    }
+    return column_nodes_[index];
+}
+
+/**
+ * Returns the contiguous values of a dense feature, or nullptr if it is stored sparse.
+ */
+const std::uint8_t *RawData::getColumn(std::uint32_t index) const
+{
+    if (index >= features_size_) {
+        throw std::out_of_range("Feature index out of range");
+    }
+    return columns_[index];
+}
+
+/**
+ * Returns the non-zero entries of a sparse feature. Empty for dense features.
+ */
+const SparseColumn &RawData::getSparseColumn(std::uint32_t index) const
+{
+    if (index >= features_size_) {
+        throw std::out_of_range("Feature index out of range");
+    }
+    return sparse_columns_[index];
+}
+
 /**
  * Returns a vector containing a feature.
  */
@@ -140,10 +732,40 @@ std::vector<std::uint8_t> RawData::fetchFeature(std::uint32_t index) const
         throw std::out_of_range("Feature index out of range");
     }
 
-    std::vector<std::uint8_t> feature(data_size_);
-    for (std::uint32_t i = 0; i < data_size_; ++i) {
-        feature[i] = data_[index * data_size_ + i];
+    if (columns_[index] == nullptr) {
+        const SparseColumn &sparse = sparse_columns_[index];
+        std::vector<std::uint8_t> feature(data_size_, 0);
+        for (std::size_t i = 0; i < sparse.rows.size(); ++i) {
+            feature[sparse.rows[i]] = sparse.values[i];
+        }
+        return feature;
+    }
+
+    const std::uint8_t *column = columns_[index];
+    return std::vector<std::uint8_t>(column, column + data_size_);
+}
+
+/**
+ * Returns a pointer to the values of a feature without allocating: dense features are returned
+ * in place and sparse ones are materialized into the given workspace slot.
+ */
+const std::uint8_t *RawData::fetchFeature(std::uint32_t index,
+                                          Workspace &workspace,
+                                          Workspace::Column slot) const
+{
+    if (index >= features_size_) {
+        throw std::out_of_range("Feature index out of range");
     }
 
-    return feature;
-}
\ No newline at end of file
+    if (columns_[index] != nullptr) {
+        return columns_[index];
+    }
+
+    const SparseColumn &sparse = sparse_columns_[index];
+    std::span<std::uint8_t> feature = workspace.column(slot, data_size_);
+    std::fill(feature.begin(), feature.end(), 0);
+    for (std::size_t i = 0; i < sparse.rows.size(); ++i) {
+        feature[sparse.rows[i]] = sparse.values[i];
+    }
+    return feature.data();
+}
@@ -17,30 +17,105 @@
 
 #pragma once
 
+#include <cstdint>
 #include <fstream>
+#include <span>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include "ColumnFormat.h"
+#include "Workspace.h"
+
+struct LoadOptions {
+    // Columns with at least this fraction of zeros are stored sparse. Values above 1 disable it.
+    double sparse_threshold = 0.95;
+    // Threads used to transpose and scan the data while loading. 0 means all hardware threads.
+    std::uint32_t threads = 0;
+    // Spreads the dense columns over the NUMA nodes of the machine.
+    bool numa = false;
+};
+
+// A column stored as its non-zero values and their row indices, sorted by row. Row indices are
+// 32-bit, so only datasets with fewer than 2^32 samples store columns sparse.
+struct SparseColumn {
+    using Row = std::uint32_t;
+
+    std::vector<Row> rows;
+    std::vector<std::uint8_t> values;
+};
+
 class RawData
 {
   public:
-    explicit RawData(const std::string& filename);
+    explicit RawData(const std::string& filename, const LoadOptions& options = LoadOptions());
+    RawData(std::span<const std::uint8_t> rows,
+            std::uint32_t features_size,
+            const LoadOptions& options = LoadOptions());
+    RawData(std::vector<const std::uint8_t*> columns,
+            std::uint64_t data_size,
+            const LoadOptions& options = LoadOptions());
     ~RawData();
 
+    RawData(const RawData&) = delete;
+    RawData& operator=(const RawData&) = delete;
+
     std::uint32_t getValuesRange(std::uint32_t index) const;
     const std::vector<std::uint32_t>& getValuesRangeArray() const;
-    std::uint32_t getDataSize() const;
+    const std::vector<std::uint64_t>& getValueCounts(std::uint32_t index) const;
+    std::uint64_t getDataSize() const;
     std::uint32_t getFeaturesSize() const;
+    std::uint32_t getSparseFeaturesSize() const;
+    std::uint32_t getConstantFeaturesSize() const;
+    std::uint32_t getDuplicateFeaturesSize() const;
+    std::uint64_t getFeatureHash(std::uint32_t index) const;
+    std::uint64_t getContentHash() const;
+
+    bool isSparse(std::uint32_t index) const;
+    bool isConstant(std::uint32_t index) const;
+    std::uint32_t getAlias(std::uint32_t index) const;
+    std::uint32_t getColumnNode(std::uint32_t index) const;
+    const std::uint8_t* getColumn(std::uint32_t index) const;
+    const SparseColumn& getSparseColumn(std::uint32_t index) const;
 
     std::vector<std::uint8_t> fetchFeature(std::uint32_t index) const;
+    const std::uint8_t* fetchFeature(std::uint32_t index,
+                                     Workspace& workspace,
+                                     Workspace::Column slot) const;
 
   private:
     void calculateVR();
     void calculateDSandFS();
+    void findRedundantColumns();
     void loadData();
+    void loadColumnar(const ColumnarHeader& header);
+    void transposeRows(const std::uint8_t* rows, std::size_t count, std::uint64_t first_row);
+    void bindColumns();
+    void analyzeColumns();
+    void compactSparse();
+    void placeColumns();
 
+    LoadOptions options_;
     std::vector<std::uint8_t> data_;
+    // Dense columns point into data_, into caller-owned memory when borrowed, or into
+    // node_buffers_ once placed on NUMA nodes; sparse ones are null and live in sparse_columns_.
+    std::vector<const std::uint8_t*> columns_;
+    bool borrowed_;
+    std::vector<std::uint32_t> column_nodes_;
+    std::vector<std::pair<void*, std::size_t>> node_buffers_;
+    std::vector<SparseColumn> sparse_columns_;
+    std::uint32_t sparse_features_size_;
     std::uint32_t features_size_;
-    std::uint32_t data_size_;
+    std::uint64_t data_size_;
+    // Offset of the rows in a row-major file.
+    std::uint64_t data_offset_;
     std::vector<std::uint32_t> values_range_;
+    std::vector<std::vector<std::uint64_t>> value_counts_;
+    std::vector<std::uint64_t> feature_hashes_;
+    // First feature with exactly the same values as each feature; itself if there is none.
+    std::vector<std::uint32_t> aliases_;
+    std::uint32_t constant_features_size_;
+    std::uint32_t duplicate_features_size_;
+    std::uint64_t content_hash_;
     std::ifstream data_file_;
 };
@@ -0,0 +1,338 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Sidecar.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+#include "Hash.h"
+#include "RawData.h"
+#include "Stats.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file. Empty if the file does not exist or is empty.
+class MappedFile
+{
+  public:
+    explicit MappedFile(const std::string &path)
+    {
+#ifdef _WIN32
+        file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) {
+            return;
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0) {
+            return;
+        }
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping_ == nullptr) {
+            return;
+        }
+        void *view = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+        if (view != nullptr) {
+            data_ = static_cast<const std::uint8_t *>(view);
+            size_ = static_cast<std::size_t>(size.QuadPart);
+        }
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            std::size_t size = static_cast<std::size_t>(info.st_size);
+            void *view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view != MAP_FAILED) {
+                data_ = static_cast<const std::uint8_t *>(view);
+                size_ = size;
+            }
+        }
+        close(fd);
+#endif
+    }
+
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if (data_ != nullptr) {
+            UnmapViewOfFile(data_);
+        }
+        if (mapping_ != nullptr) {
+            CloseHandle(mapping_);
+        }
+        if (file_ != INVALID_HANDLE_VALUE) {
+            CloseHandle(file_);
+        }
+#else
+        if (data_ != nullptr) {
+            munmap(const_cast<std::uint8_t *>(data_), size_);
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const std::uint8_t *data() const
+    {
+        return data_;
+    }
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+  private:
+    const std::uint8_t *data_ = nullptr;
+    std::size_t size_ = 0;
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#endif
+};
+
+namespace
+{
+constexpr char kMagic[4] = {'M', 'R', 'S', 'C'};
+constexpr std::uint32_t kVersion = 2;
+
+// The entries follow the header, sorted by (index1, index2, index3). Version 1 files also held
+// the value ranges and marginal counts and are ignored.
+struct Header {
+    char magic[4];
+    std::uint32_t version;
+    std::uint64_t content_hash;
+    std::uint64_t data_size;
+    std::uint32_t features_size;
+    std::uint32_t reserved;
+    std::uint64_t entries_offset;
+    std::uint64_t entries_size;
+};
+
+static_assert(sizeof(Header) == 48);
+static_assert(sizeof(Sidecar::Entry) == 24);
+
+auto entryKey(const Sidecar::Entry &entry)
+{
+    return std::tie(entry.index1, entry.index2, entry.index3);
+}
+}  // namespace
+
+std::size_t Sidecar::KeyHash::operator()(const Key &key) const
+{
+    return static_cast<std::size_t>(
+        hashCombine(hashCombine(key.index1, key.index2), key.index3));
+}
+
+/**
+ * Opens the sidecar at path and maps it if it was written for the same data as rd.
+ * A missing, stale or unreadable sidecar is not an error: the cache simply starts empty.
+ */
+Sidecar::Sidecar(std::string path, const RawData &rd)
+    : path_(std::move(path)),
+      raw_data_(rd),
+      loaded_(false),
+      entries_(nullptr),
+      entries_size_(0)
+{
+    map();
+}
+
+Sidecar::~Sidecar() = default;
+
+void Sidecar::map()
+{
+    file_ = std::make_unique<MappedFile>(path_);
+    loaded_ = false;
+    entries_ = nullptr;
+    entries_size_ = 0;
+
+    const std::uint8_t *data = file_->data();
+    std::size_t size = file_->size();
+    if (data == nullptr || size < sizeof(Header)) {
+        return;
+    }
+
+    Header header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion
+        || header.content_hash != raw_data_.getContentHash()
+        || header.data_size != raw_data_.getDataSize()
+        || header.features_size != raw_data_.getFeaturesSize()) {
+        return;
+    }
+
+    // The entries must fit in the file
+    if (header.entries_offset > size
+        || header.entries_size > (size - header.entries_offset) / sizeof(Entry)) {
+        return;
+    }
+
+    loaded_ = true;
+    entries_ = reinterpret_cast<const Entry *>(data + header.entries_offset);
+    entries_size_ = header.entries_size;
+}
+
+// True when an existing sidecar matched the dataset.
+bool Sidecar::isLoaded() const
+{
+    return loaded_;
+}
+
+Sidecar::Shard &Sidecar::shardFor(const Key &key) const
+{
+    return shards_[KeyHash()(key) % kShards];
+}
+
+/**
+ * Looks up a cached term, first in the mapped file and then among the terms added in this run.
+ *
+ * @return Whether the term was found; value is only set when it was
+ */
+bool Sidecar::find(std::uint32_t index1,
+                   std::uint32_t index2,
+                   std::uint32_t index3,
+                   double &value) const
+{
+    Entry probe{index1, index2, index3, 0, 0.0};
+    const Entry *end = entries_ + entries_size_;
+    const Entry *it = std::lower_bound(entries_, end, probe, [](const Entry &a, const Entry &b) {
+        return entryKey(a) < entryKey(b);
+    });
+    if (it != end && entryKey(*it) == entryKey(probe)) {
+        value = it->value;
+        Stats::instance().add(Stats::Counter::SidecarHits);
+        return true;
+    }
+
+    Key key{index1, index2, index3};
+    Shard &shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.entries.find(key);
+    if (found == shard.entries.end()) {
+        Stats::instance().add(Stats::Counter::SidecarMisses);
+        return false;
+    }
+    value = found->second;
+    Stats::instance().add(Stats::Counter::SidecarHits);
+    return true;
+}
+
+// Records a term computed in this run. Thread-safe.
+void Sidecar::insert(std::uint32_t index1, std::uint32_t index2, std::uint32_t index3, double value)
+{
+    Key key{index1, index2, index3};
+    Shard &shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.entries.emplace(key, value);
+}
+
+// Number of terms available, mapped and new.
+std::uint64_t Sidecar::size() const
+{
+    std::uint64_t size = entries_size_;
+    for (const Shard &shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        size += shard.entries.size();
+    }
+    return size;
+}
+
+/**
+ * Writes the mapped terms merged with the new ones to a temporary file that then replaces the
+ * sidecar. The new file is mapped afterwards.
+ */
+void Sidecar::save()
+{
+    std::vector<Entry> added;
+    for (Shard &shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (const auto &[key, value] : shard.entries) {
+            added.push_back({key.index1, key.index2, key.index3, 0, value});
+        }
+    }
+    auto less = [](const Entry &a, const Entry &b) { return entryKey(a) < entryKey(b); };
+    std::sort(added.begin(), added.end(), less);
+
+    std::vector<Entry> merged;
+    merged.reserve(entries_size_ + added.size());
+    std::merge(entries_, entries_ + entries_size_, added.begin(), added.end(),
+               std::back_inserter(merged), less);
+    merged.erase(std::unique(merged.begin(), merged.end(),
+                             [](const Entry &a, const Entry &b) {
+                                 return entryKey(a) == entryKey(b);
+                             }),
+                 merged.end());
+
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.content_hash = raw_data_.getContentHash();
+    header.data_size = raw_data_.getDataSize();
+    header.features_size = raw_data_.getFeaturesSize();
+    header.entries_offset = sizeof(Header);
+    header.entries_size = merged.size();
+
+    const std::string temporary = path_ + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Could not open file: " + temporary);
+        }
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(merged.data()),
+                  static_cast<std::streamsize>(sizeof(Entry) * merged.size()));
+        if (!out) {
+            throw std::runtime_error("Failed to write file: " + temporary);
+        }
+    }
+
+    // The old mapping must be released before the file can be replaced on Windows
+    file_.reset();
+    entries_ = nullptr;
+    entries_size_ = 0;
+    std::filesystem::rename(temporary, path_);
+
+    for (Shard &shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.entries.clear();
+    }
+    map();
+}
@@ -0,0 +1,105 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class RawData;
+class MappedFile;
+
+/**
+ * Persistent cache of every mutual information term a selection run computes (class relevances,
+ * pairwise and conditional MI). Marginals are not stored: RawData counts values while loading.
+ * It is keyed by RawData::getContentHash(), so it is only reused for identical data, and is
+ * memory-mapped and searched in place on the next run. Terms computed during the run are kept in
+ * memory until save() merges them into the file.
+ *
+ * The file stores native-endian structs; a sidecar written on a different architecture is simply
+ * ignored.
+ */
+class Sidecar
+{
+  public:
+    // Third index of entries that are not conditional.
+    static constexpr std::uint32_t kNone = UINT32_MAX;
+
+    Sidecar(std::string path, const RawData &rd);
+    ~Sidecar();
+
+    Sidecar(const Sidecar &) = delete;
+    Sidecar &operator=(const Sidecar &) = delete;
+
+    bool isLoaded() const;
+
+    bool find(std::uint32_t index1,
+              std::uint32_t index2,
+              std::uint32_t index3,
+              double &value) const;
+    void insert(std::uint32_t index1, std::uint32_t index2, std::uint32_t index3, double value);
+
+    std::uint64_t size() const;
+    void save();
+
+    struct Entry {
+        std::uint32_t index1;
+        std::uint32_t index2;
+        std::uint32_t index3;
+        std::uint32_t reserved;
+        double value;
+    };
+
+  private:
+    struct Key {
+        std::uint32_t index1;
+        std::uint32_t index2;
+        std::uint32_t index3;
+
+        bool operator==(const Key &other) const = default;
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key &key) const;
+    };
+
+    // New entries are spread over shards so that worker threads rarely contend.
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<Key, double, KeyHash> entries;
+    };
+
+    static constexpr std::size_t kShards = 64;
+
+    void map();
+    Shard &shardFor(const Key &key) const;
+
+    std::string path_;
+    const RawData &raw_data_;
+
+    std::unique_ptr<MappedFile> file_;
+    bool loaded_;
+    const Entry *entries_;
+    std::uint64_t entries_size_;
+
+    mutable std::array<Shard, kShards> shards_;
+};
@@ -0,0 +1,182 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Stats.h"
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+Stats &Stats::instance()
+{
+    static Stats stats;
+    return stats;
+}
+
+std::uint64_t Stats::get(Counter counter) const noexcept
+{
+    return counters_[static_cast<std::size_t>(counter)].load(std::memory_order_relaxed);
+}
+
+void Stats::setValue(const std::string &key, std::uint64_t value)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    values_[key] = value;
+}
+
+void Stats::recordPhase(const std::string &name, double wall_ms, double cpu_ms)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    phases_.push_back({name, wall_ms, cpu_ms});
+}
+
+void Stats::recordStep(double wall_ms)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    steps_.push_back(wall_ms);
+}
+
+/**
+ * Returns the CPU time consumed by the whole process (all threads), in milliseconds.
+ */
+double Stats::cpuTimeMs()
+{
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        return 0.0;
+    }
+    auto to_100ns = [](const FILETIME &ft) {
+        return (static_cast<std::uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+    };
+    return static_cast<double>(to_100ns(kernel) + to_100ns(user)) / 1e4;
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0.0;
+    }
+    auto to_ms = [](const timeval &tv) {
+        return static_cast<double>(tv.tv_sec) * 1e3 + static_cast<double>(tv.tv_usec) / 1e3;
+    };
+    return to_ms(usage.ru_utime) + to_ms(usage.ru_stime);
+#endif
+}
+
+/**
+ * Returns the peak resident set size of the process, in bytes.
+ */
+std::uint64_t Stats::peakRssBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return static_cast<std::uint64_t>(counters.PeakWorkingSetSize);
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<std::uint64_t>(usage.ru_maxrss);
+#else
+    return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+// Writes every recorded metric as a single JSON object.
+void Stats::writeJson(std::ostream &os) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto quote = [](const std::string &s) {
+        std::string out = "\"";
+        for (char c : s) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+            }
+            out += c;
+        }
+        return out + "\"";
+    };
+
+    os << "{\n  \"values\": {";
+    bool first = true;
+    for (const auto &[key, value] : values_) {
+        os << (first ? "" : ",") << "\n    " << quote(key) << ": " << value;
+        first = false;
+    }
+    os << "\n  },\n  \"phases\": [";
+    first = true;
+    for (const Phase &phase : phases_) {
+        os << (first ? "" : ",") << "\n    {\"name\": " << quote(phase.name)
+           << ", \"wall_ms\": " << phase.wall_ms << ", \"cpu_ms\": " << phase.cpu_ms << "}";
+        first = false;
+    }
+
+    os << "\n  ],\n  \"counters\": {"
+       << "\n    \"bytes_loaded\": " << get(Counter::BytesLoaded) << ","
+       << "\n    \"joint_tables_built\": " << get(Counter::JointTablesBuilt) << ","
+       << "\n    \"histograms_built\": " << get(Counter::HistogramsBuilt) << ","
+       << "\n    \"bytes_scanned\": " << get(Counter::BytesScanned) << ","
+       << "\n    \"mutual_info_calls\": " << get(Counter::MutualInfoCalls) << ","
+       << "\n    \"marginal_lookups\": " << get(Counter::MarginalLookups) << ","
+       << "\n    \"sidecar\": {\"hits\": " << get(Counter::SidecarHits)
+       << ", \"misses\": " << get(Counter::SidecarMisses) << "}"
+       << "\n  },";
+
+    double total = std::accumulate(steps_.begin(), steps_.end(), 0.0);
+    double max = steps_.empty() ? 0.0 : *std::max_element(steps_.begin(), steps_.end());
+    double mean = steps_.empty() ? 0.0 : total / static_cast<double>(steps_.size());
+
+    os << "\n  \"greedy_steps\": {\"count\": " << steps_.size() << ", \"total_ms\": " << total
+       << ", \"mean_ms\": " << mean << ", \"max_ms\": " << max << ", \"wall_ms\": [";
+    for (std::size_t i = 0; i < steps_.size(); ++i) {
+        os << (i == 0 ? "" : ", ") << steps_[i];
+    }
+    os << "]},\n  \"peak_rss_bytes\": " << peakRssBytes() << "\n}\n";
+}
+
+ScopedPhase::ScopedPhase(std::string name)
+    : name_(std::move(name)),
+      wall_start_(std::chrono::steady_clock::now()),
+      cpu_start_(Stats::cpuTimeMs())
+{
+}
+
+ScopedPhase::~ScopedPhase()
+{
+    double wall_ms =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wall_start_)
+            .count();
+    Stats::instance().recordPhase(name_, wall_ms, Stats::cpuTimeMs() - cpu_start_);
+}
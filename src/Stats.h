@@ -0,0 +1,96 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Process-wide instrumentation for the hot paths. Counters are relaxed atomics that are
+// bumped once per table or per call (never per row), so leaving them on costs nothing
+// measurable. Phases and greedy steps are recorded under a mutex since they are rare.
+class Stats
+{
+  public:
+    enum class Counter {
+        BytesLoaded,
+        JointTablesBuilt,
+        HistogramsBuilt,
+        BytesScanned,
+        MutualInfoCalls,
+        MarginalLookups,
+        SidecarHits,
+        SidecarMisses,
+        Count
+    };
+
+    static Stats &instance();
+
+    void add(Counter counter, std::uint64_t amount = 1) noexcept
+    {
+        counters_[static_cast<std::size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    std::uint64_t get(Counter counter) const noexcept;
+
+    void setValue(const std::string &key, std::uint64_t value);
+    void recordPhase(const std::string &name, double wall_ms, double cpu_ms);
+    void recordStep(double wall_ms);
+
+    void writeJson(std::ostream &os) const;
+
+    static double cpuTimeMs();
+    static std::uint64_t peakRssBytes();
+
+  private:
+    Stats() = default;
+
+    struct Phase {
+        std::string name;
+        double wall_ms;
+        double cpu_ms;
+    };
+
+    std::array<std::atomic<std::uint64_t>, static_cast<std::size_t>(Counter::Count)> counters_{};
+    mutable std::mutex mutex_;
+    std::map<std::string, std::uint64_t> values_;
+    std::vector<Phase> phases_;
+    std::vector<double> steps_;
+};
+
+// Records the wall and CPU time spent between construction and destruction as a named phase.
+class ScopedPhase
+{
+  public:
+    explicit ScopedPhase(std::string name);
+    ~ScopedPhase();
+
+    ScopedPhase(const ScopedPhase &) = delete;
+    ScopedPhase &operator=(const ScopedPhase &) = delete;
+
+  private:
+    std::string name_;
+    std::chrono::steady_clock::time_point wall_start_;
+    double cpu_start_;
+};
@@ -0,0 +1,534 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SubsetSelector.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <optional>
+#include <random>
+#include <stdexcept>
+
+#include "Parallel.h"
+#include "Stats.h"
+#include "Workspace.h"
+
+/**
+ * Training subsets of k-fold cross-validation: subset k leaves out the rows i with
+ * i % folds == k.
+ */
+std::vector<RowWeights> makeFolds(std::uint64_t data_size, std::uint32_t folds)
+{
+    if (folds < 2) {
+        throw std::invalid_argument("At least two folds are needed");
+    }
+    std::vector<RowWeights> subsets(folds, RowWeights(data_size, 1));
+    for (std::uint64_t i = 0; i < data_size; ++i) {
+        subsets[i % folds][i] = 0;
+    }
+    return subsets;
+}
+
+/**
+ * Bootstrap resamples: each subset draws data_size rows with replacement. Weights saturate at
+ * 255, which only matters for tiny datasets.
+ */
+std::vector<RowWeights> makeBootstraps(std::uint64_t data_size,
+                                       std::uint32_t samples,
+                                       std::uint64_t seed)
+{
+    std::mt19937_64 generator(seed);
+    std::vector<RowWeights> subsets(samples, RowWeights(data_size, 0));
+    if (data_size == 0) {
+        return subsets;
+    }
+    std::uniform_int_distribution<std::uint64_t> row(0, data_size - 1);
+    for (RowWeights &weights : subsets) {
+        for (std::uint64_t i = 0; i < data_size; ++i) {
+            std::uint8_t &weight = weights[row(generator)];
+            if (weight < UINT8_MAX) {
+                weight++;
+            }
+        }
+    }
+    return subsets;
+}
+
+SubsetSelector::SubsetSelector(const RawData &rd, std::uint32_t class_index, Criterion criterion)
+    : raw_data_(rd),
+      class_index_(class_index),
+      criterion_(criterion),
+      threads_(defaultThreads()),
+      stop_(nullptr),
+      interrupted_(false),
+      wide_counts_(false),
+      candidates_size_(0)
+{
+    if (class_index_ >= raw_data_.getFeaturesSize()) {
+        throw std::out_of_range("Class index out of range");
+    }
+}
+
+void SubsetSelector::setThreads(std::uint32_t threads)
+{
+    threads_ = std::max<std::uint32_t>(threads, 1);
+}
+
+// Stops the selection once the deadline passes; a step in progress is abandoned.
+void SubsetSelector::setDeadline(std::optional<Clock::time_point> deadline)
+{
+    deadline_ = deadline;
+}
+
+// Stops the selection as soon as *stop becomes true. Setting it from a signal handler is safe.
+void SubsetSelector::setStopFlag(const std::atomic<bool> *stop)
+{
+    stop_ = stop;
+}
+
+// Whether the last select() stopped early because of the deadline or the stop flag.
+bool SubsetSelector::wasInterrupted() const
+{
+    return interrupted_.load();
+}
+
+// Checked between features, so a step overruns the deadline by about one group pass.
+bool SubsetSelector::shouldStop()
+{
+    if (interrupted_.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    if ((stop_ != nullptr && stop_->load(std::memory_order_relaxed))
+        || (deadline_ && Clock::now() >= *deadline_)) {
+        interrupted_ = true;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Adds a subset given the weight of every row. The weighted number of rows must be positive.
+ */
+void SubsetSelector::addSubset(std::span<const std::uint8_t> weights)
+{
+    if (weights.size() != raw_data_.getDataSize()) {
+        throw std::invalid_argument("Subset weights must have one entry per row");
+    }
+    std::uint64_t total = 0;
+    for (std::uint8_t weight : weights) {
+        total += weight;
+    }
+    if (total == 0) {
+        throw std::invalid_argument("Subset weights must add up to at least 1");
+    }
+    subsets_.emplace_back(weights.begin(), weights.end());
+    totals_.push_back(total);
+}
+
+std::size_t SubsetSelector::getSubsetsSize() const
+{
+    return subsets_.size();
+}
+
+SubsetSelector::Group SubsetSelector::makeGroup(const std::vector<std::uint32_t> &subsets) const
+{
+    const std::size_t data_size = raw_data_.getDataSize();
+    const std::size_t group_size = subsets.size();
+    Group group{subsets, std::vector<std::uint8_t>(data_size * group_size)};
+    for (std::size_t g = 0; g < group_size; ++g) {
+        const RowWeights &weights = subsets_[subsets[g]];
+        for (std::size_t r = 0; r < data_size; ++r) {
+            group.weights[r * group_size + g] = weights[r];
+        }
+    }
+    return group;
+}
+
+// Weighted value counts of every feature in every subset, one pass per feature.
+void SubsetSelector::computeMarginals()
+{
+    const Group all = [this] {
+        std::vector<std::uint32_t> ids(subsets_.size());
+        for (std::uint32_t s = 0; s < ids.size(); ++s) {
+            ids[s] = s;
+        }
+        return makeGroup(ids);
+    }();
+    const std::size_t subsets = subsets_.size();
+    const std::uint64_t data_size = raw_data_.getDataSize();
+
+    marginals_.resize(raw_data_.getFeaturesSize());
+    parallelFor(marginals_.size(), threads_, [&](std::size_t f) {
+        if (shouldStop()) {
+            return;
+        }
+        std::uint32_t index = static_cast<std::uint32_t>(f);
+        std::vector<std::uint64_t> &counts = marginals_[f];
+        counts.assign(raw_data_.getValuesRange(index) * subsets, 0);
+        const std::uint8_t *column =
+            raw_data_.fetchFeature(index, Workspace::local(), Workspace::Column::First);
+        for (std::size_t r = 0; r < data_size; ++r) {
+            std::uint64_t *cell = counts.data() + column[r] * subsets;
+            const std::uint8_t *weights = all.weights.data() + r * subsets;
+            for (std::size_t s = 0; s < subsets; ++s) {
+                cell[s] += weights[s];
+            }
+        }
+    });
+}
+
+/**
+ * I(index1; index2) in every subset of the group, from a single pass over the rows. Uses the
+ * arithmetic of MutualInfo::fetch.
+ */
+void SubsetSelector::mutualInfo(const Group &group,
+                                std::uint32_t index1,
+                                std::uint32_t index2,
+                                std::span<double> out) const
+{
+    const std::size_t group_size = group.subsets.size();
+    const std::size_t subsets = subsets_.size();
+    const std::uint32_t range1 = raw_data_.getValuesRange(index1);
+    const std::uint32_t range2 = raw_data_.getValuesRange(index2);
+    const std::uint64_t data_size = raw_data_.getDataSize();
+    constexpr double epsilon = 1e-10;
+
+    Workspace &workspace = Workspace::local();
+    const std::size_t table_size = range1 * range2 * group_size;
+    std::span<std::uint32_t> table;
+    std::span<std::uint64_t> wide_table;
+    const std::uint8_t *values1 =
+        raw_data_.fetchFeature(index1, workspace, Workspace::Column::First);
+    const std::uint8_t *values2 =
+        raw_data_.fetchFeature(index2, workspace, Workspace::Column::Second);
+
+    auto fill = [&](auto counts) {
+        for (std::size_t r = 0; r < data_size; ++r) {
+            auto *cell = counts.data() + (values1[r] * range2 + values2[r]) * group_size;
+            const std::uint8_t *weights = group.weights.data() + r * group_size;
+            for (std::size_t g = 0; g < group_size; ++g) {
+                cell[g] += weights[g];
+            }
+        }
+    };
+    if (wide_counts_) {
+        wide_table = workspace.wideTable(Workspace::Table::Joint, table_size);
+        fill(wide_table);
+    } else {
+        table = workspace.table(Workspace::Table::Joint, table_size);
+        fill(table);
+    }
+    auto count = [&](std::size_t cell) -> std::uint64_t {
+        return wide_counts_ ? wide_table[cell] : table[cell];
+    };
+
+    const std::vector<std::uint64_t> &marginal1 = marginals_[index1];
+    const std::vector<std::uint64_t> &marginal2 = marginals_[index2];
+    for (std::size_t g = 0; g < group_size; ++g) {
+        const std::uint32_t s = group.subsets[g];
+        const double total = static_cast<double>(totals_[s]);
+        double mutual_info = 0;
+        for (std::uint32_t i = 0; i < range1; i++) {
+            for (std::uint32_t j = 0; j < range2; j++) {
+                double joint_probability =
+                    static_cast<double>(count((i * range2 + j) * group_size + g)) / total;
+                if (joint_probability > epsilon) {
+                    double marginalX = static_cast<double>(marginal1[i * subsets + s]) / total;
+                    double marginalY = static_cast<double>(marginal2[j * subsets + s]) / total;
+                    if (marginalX > 0 && marginalY > 0) {
+                        double division = joint_probability / (marginalX * marginalY);
+                        mutual_info += joint_probability * std::log2(division);
+                    }
+                }
+            }
+        }
+        out[g] = mutual_info;
+    }
+
+    Stats::instance().add(Stats::Counter::JointTablesBuilt);
+    Stats::instance().add(Stats::Counter::BytesScanned, (2 + group_size) * data_size);
+}
+
+/**
+ * I(index1; index2 | condition) in every subset of the group, from a single pass over the rows.
+ * Uses the arithmetic of MutualInfo::fetchConditional.
+ */
+void SubsetSelector::conditionalMutualInfo(const Group &group,
+                                           std::uint32_t index1,
+                                           std::uint32_t index2,
+                                           std::uint32_t condition,
+                                           std::span<double> out) const
+{
+    const std::size_t group_size = group.subsets.size();
+    const std::size_t subsets = subsets_.size();
+    const std::uint32_t range1 = raw_data_.getValuesRange(index1);
+    const std::uint32_t range2 = raw_data_.getValuesRange(index2);
+    const std::uint32_t range3 = raw_data_.getValuesRange(condition);
+    const std::uint64_t data_size = raw_data_.getDataSize();
+    constexpr double epsilon = 1e-10;
+
+    Workspace &workspace = Workspace::local();
+    const std::size_t table_size = range1 * range2 * range3 * group_size;
+    std::span<std::uint32_t> table;
+    std::span<std::uint64_t> wide_table;
+    const std::uint8_t *values1 =
+        raw_data_.fetchFeature(index1, workspace, Workspace::Column::First);
+    const std::uint8_t *values2 =
+        raw_data_.fetchFeature(index2, workspace, Workspace::Column::Second);
+    const std::uint8_t *values3 =
+        raw_data_.fetchFeature(condition, workspace, Workspace::Column::Third);
+
+    auto fill = [&](auto counts) {
+        for (std::size_t r = 0; r < data_size; ++r) {
+            auto *cell = counts.data()
+                         + ((values1[r] * range2 + values2[r]) * range3 + values3[r]) * group_size;
+            const std::uint8_t *weights = group.weights.data() + r * group_size;
+            for (std::size_t g = 0; g < group_size; ++g) {
+                cell[g] += weights[g];
+            }
+        }
+    };
+    if (wide_counts_) {
+        wide_table = workspace.wideTable(Workspace::Table::Joint, table_size);
+        fill(wide_table);
+    } else {
+        table = workspace.table(Workspace::Table::Joint, table_size);
+        fill(table);
+    }
+    auto count = [&](std::size_t cell) -> std::uint64_t {
+        return wide_counts_ ? wide_table[cell] : table[cell];
+    };
+
+    const std::vector<std::uint64_t> &marginal3 = marginals_[condition];
+    for (std::size_t g = 0; g < group_size; ++g) {
+        const std::uint32_t s = group.subsets[g];
+        const double total = static_cast<double>(totals_[s]);
+        auto probability = [&](std::uint32_t i, std::uint32_t j, std::uint32_t k) {
+            return static_cast<double>(count(((i * range2 + j) * range3 + k) * group_size + g))
+                   / total;
+        };
+
+        std::span<double> marginal_xz =
+            workspace.buffer(Workspace::Buffer::Marginal1, range1 * range3);
+        std::span<double> marginal_yz =
+            workspace.buffer(Workspace::Buffer::Marginal2, range2 * range3);
+        for (std::uint32_t i = 0; i < range1; i++) {
+            for (std::uint32_t j = 0; j < range2; j++) {
+                for (std::uint32_t k = 0; k < range3; k++) {
+                    double joint_probability = probability(i, j, k);
+                    marginal_xz[i * range3 + k] += joint_probability;
+                    marginal_yz[j * range3 + k] += joint_probability;
+                }
+            }
+        }
+
+        double mutual_info = 0;
+        for (std::uint32_t i = 0; i < range1; i++) {
+            for (std::uint32_t j = 0; j < range2; j++) {
+                for (std::uint32_t k = 0; k < range3; k++) {
+                    double joint_probability = probability(i, j, k);
+                    if (joint_probability > epsilon) {
+                        double marginalZ =
+                            static_cast<double>(marginal3[k * subsets + s]) / total;
+                        double division =
+                            (marginalZ * joint_probability)
+                            / (marginal_xz[i * range3 + k] * marginal_yz[j * range3 + k]);
+                        mutual_info += joint_probability * std::log2(division);
+                    }
+                }
+            }
+        }
+        out[g] = mutual_info;
+    }
+
+    Stats::instance().add(Stats::Counter::JointTablesBuilt);
+    Stats::instance().add(Stats::Counter::BytesScanned, (3 + group_size) * data_size);
+}
+
+bool SubsetSelector::isCandidate(std::uint32_t subset, std::uint32_t index) const
+{
+    return candidates_[index] && !selected_mask_[subset][index];
+}
+
+/**
+ * Selects up to count features in every subset added so far. When the deadline passes or the
+ * stop flag is raised, the step in progress is dropped for the groups it had not finished and
+ * every subset keeps the features decided so far; none are returned if the marginals or the
+ * relevances were not complete.
+ *
+ * @param count Number of features to select per subset
+ * @return The selection of each subset and how often each feature was selected
+ */
+SubsetSelection SubsetSelector::select(std::uint32_t count)
+{
+    const std::uint32_t features_size = raw_data_.getFeaturesSize();
+    const std::uint32_t subsets = static_cast<std::uint32_t>(subsets_.size());
+    SubsetSelection result;
+    result.selections.resize(subsets);
+    result.frequencies.assign(features_size, 0);
+
+    relevances_.assign(subsets, std::vector<double>(features_size, 0.0));
+    accumulated_.assign(subsets, std::vector<double>(features_size, 0.0));
+    selected_mask_.assign(subsets, std::vector<bool>(features_size, false));
+    selected_.assign(subsets, {});
+    interrupted_ = false;
+    wide_counts_ =
+        !totals_.empty() && *std::max_element(totals_.begin(), totals_.end()) > UINT32_MAX;
+    candidates_ = candidateFeatures(raw_data_, class_index_);
+    candidates_size_ =
+        static_cast<std::uint32_t>(std::count(candidates_.begin(), candidates_.end(), true));
+    if (subsets == 0) {
+        return result;
+    }
+
+    std::optional<ScopedPhase> phase;
+    phase.emplace("subsets/marginals");
+    computeMarginals();
+    if (interrupted_) {
+        return result;
+    }
+
+    std::vector<std::uint32_t> all(subsets);
+    for (std::uint32_t s = 0; s < subsets; ++s) {
+        all[s] = s;
+    }
+
+    phase.emplace("relevance");
+    {
+        Group group = makeGroup(all);
+        std::vector<double> values(static_cast<std::size_t>(features_size) * subsets);
+        parallelFor(features_size, threads_, [&](std::size_t j) {
+            std::uint32_t index = static_cast<std::uint32_t>(j);
+            if (candidates_[index] && !shouldStop()) {
+                mutualInfo(group,
+                           class_index_,
+                           index,
+                           std::span<double>(values.data() + j * subsets, subsets));
+            }
+        });
+        for (std::uint32_t s = 0; s < subsets; ++s) {
+            for (std::uint32_t j = 0; j < features_size; ++j) {
+                relevances_[s][j] = values[static_cast<std::size_t>(j) * subsets + s];
+            }
+            if (criterion_ == Criterion::CMIM) {
+                accumulated_[s] = relevances_[s];
+            }
+        }
+    }
+
+    if (candidates_size_ == 0 || interrupted_) {
+        return result;
+    }
+
+    phase.emplace("selection");
+    std::vector<SelectedFeature> next(subsets);
+    for (std::uint32_t s = 0; s < subsets; ++s) {
+        next[s] = {0, -std::numeric_limits<double>::infinity()};
+        for (std::uint32_t j = 0; j < features_size; ++j) {
+            if (isCandidate(s, j) && relevances_[s][j] > next[s].score) {
+                next[s] = {j, relevances_[s][j]};
+            }
+        }
+    }
+
+    std::vector<std::uint32_t> active = all;
+    while (true) {
+        // Record each active subset's pick; subsets that are done drop out, and all of them once
+        // the run is interrupted
+        std::map<std::uint32_t, std::vector<std::uint32_t>> by_last;
+        for (std::uint32_t s : active) {
+            selected_[s].push_back(next[s].index);
+            selected_mask_[s][next[s].index] = true;
+            result.selections[s].push_back(next[s]);
+            result.frequencies[next[s].index]++;
+
+            if (selected_[s].size() < candidates_size_ && selected_[s].size() < count) {
+                by_last[next[s].index].push_back(s);
+            }
+        }
+        if (by_last.empty() || interrupted_) {
+            break;
+        }
+
+        auto step_start = std::chrono::steady_clock::now();
+        active.clear();
+        for (const auto &[last, members] : by_last) {
+            if (shouldStop()) {
+                break;
+            }
+            Group group = makeGroup(members);
+            const std::size_t group_size = members.size();
+            std::vector<double> values(static_cast<std::size_t>(features_size) * group_size);
+
+            parallelFor(features_size, threads_, [&](std::size_t j) {
+                std::uint32_t index = static_cast<std::uint32_t>(j);
+                bool needed = false;
+                for (std::uint32_t s : members) {
+                    needed = needed || isCandidate(s, index);
+                }
+                if (!needed || shouldStop()) {
+                    return;
+                }
+                std::span<double> out(values.data() + j * group_size, group_size);
+                if (criterion_ == Criterion::MRMR) {
+                    mutualInfo(group, last, index, out);
+                } else {
+                    conditionalMutualInfo(group, index, class_index_, last, out);
+                }
+            });
+            if (interrupted_) {
+                break;
+            }
+
+            for (std::size_t g = 0; g < group_size; ++g) {
+                const std::uint32_t s = members[g];
+                const double selected_size = static_cast<double>(selected_[s].size());
+                SelectedFeature best{0, -std::numeric_limits<double>::infinity()};
+                for (std::uint32_t j = 0; j < features_size; ++j) {
+                    if (!isCandidate(s, j)) {
+                        continue;
+                    }
+                    const double value = values[static_cast<std::size_t>(j) * group_size + g];
+                    double score = 0;
+                    if (criterion_ == Criterion::MRMR) {
+                        accumulated_[s][j] += value;
+                        score = relevances_[s][j] - (accumulated_[s][j] / selected_size);
+                    } else if (criterion_ == Criterion::JMI) {
+                        accumulated_[s][j] += relevances_[s][last] + value;
+                        score = accumulated_[s][j];
+                    } else {
+                        accumulated_[s][j] = std::min(accumulated_[s][j], value);
+                        score = accumulated_[s][j];
+                    }
+                    if (score > best.score) {
+                        best = {j, score};
+                    }
+                }
+                next[s] = best;
+                active.push_back(s);
+            }
+        }
+        Stats::instance().recordStep(
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - step_start)
+                .count());
+    }
+
+    return result;
+}
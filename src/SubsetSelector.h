@@ -0,0 +1,119 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "FeatureSelector.h"
+#include "RawData.h"
+
+// How many times each row counts in a subset: 0 leaves the row out, 1 keeps it, and larger
+// values repeat it (bootstrap resampling).
+using RowWeights = std::vector<std::uint8_t>;
+
+std::vector<RowWeights> makeFolds(std::uint64_t data_size, std::uint32_t folds);
+std::vector<RowWeights> makeBootstraps(std::uint64_t data_size,
+                                       std::uint32_t samples,
+                                       std::uint64_t seed);
+
+struct SubsetSelection {
+    // Selected features of each subset, in selection order.
+    std::vector<std::vector<SelectedFeature>> selections;
+    // Number of subsets that selected each feature.
+    std::vector<std::uint32_t> frequencies;
+};
+
+/**
+ * Runs the greedy selection of FeatureSelector on many row subsets of one dataset at once.
+ * Every joint histogram is built for a group of subsets in a single pass over the rows, with
+ * one counter per subset in each cell, so the columns are scanned once per step and group
+ * instead of once per subset. Subsets are grouped by the feature they selected last, which
+ * for overlapping subsets such as cross-validation folds is usually the same.
+ *
+ * A subset weighting every row once selects exactly what FeatureSelector selects.
+ */
+class SubsetSelector
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    SubsetSelector(const RawData &rd, std::uint32_t class_index, Criterion criterion);
+
+    void setThreads(std::uint32_t threads);
+    void setDeadline(std::optional<Clock::time_point> deadline);
+    void setStopFlag(const std::atomic<bool> *stop);
+
+    void addSubset(std::span<const std::uint8_t> weights);
+    std::size_t getSubsetsSize() const;
+
+    SubsetSelection select(std::uint32_t count);
+    bool wasInterrupted() const;
+
+  private:
+    // Subsets sharing the pass, and their weights interleaved row by row.
+    struct Group {
+        std::vector<std::uint32_t> subsets;
+        std::vector<std::uint8_t> weights;
+    };
+
+    Group makeGroup(const std::vector<std::uint32_t> &subsets) const;
+    void computeMarginals();
+    void mutualInfo(const Group &group,
+                    std::uint32_t index1,
+                    std::uint32_t index2,
+                    std::span<double> out) const;
+    void conditionalMutualInfo(const Group &group,
+                               std::uint32_t index1,
+                               std::uint32_t index2,
+                               std::uint32_t condition,
+                               std::span<double> out) const;
+    bool isCandidate(std::uint32_t subset, std::uint32_t index) const;
+    bool shouldStop();
+
+    const RawData &raw_data_;
+    std::uint32_t class_index_;
+    Criterion criterion_;
+    std::uint32_t threads_;
+
+    // Same anytime stop as FeatureSelector: each subset keeps the features decided so far.
+    std::optional<Clock::time_point> deadline_;
+    const std::atomic<bool> *stop_;
+    std::atomic<bool> interrupted_;
+
+    std::vector<RowWeights> subsets_;
+    std::vector<std::uint64_t> totals_;
+    // Whether a subset weighs more than 2^32 - 1 rows, so joint tables need 64-bit counters.
+    bool wide_counts_;
+    // Per feature, the weighted count of each value in each subset: [value * subsets + subset].
+    std::vector<std::vector<std::uint64_t>> marginals_;
+
+    // Features that may be selected in any subset, see candidateFeatures().
+    std::vector<bool> candidates_;
+    std::uint32_t candidates_size_;
+
+    // Per subset state, indexed [subset][feature].
+    std::vector<std::vector<double>> relevances_;
+    std::vector<std::vector<double>> accumulated_;
+    std::vector<std::vector<bool>> selected_mask_;
+    std::vector<std::vector<std::uint32_t>> selected_;
+};
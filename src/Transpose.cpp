@@ -0,0 +1,110 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Transpose.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MRMR_TRANSPOSE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+constexpr std::size_t kTile = 16;
+
+void transposeTileScalar(const std::uint8_t *src,
+                         std::size_t src_stride,
+                         std::size_t rows,
+                         std::size_t columns,
+                         std::uint8_t *dst,
+                         std::size_t dst_stride)
+{
+    for (std::size_t j = 0; j < columns; ++j) {
+        for (std::size_t i = 0; i < rows; ++i) {
+            dst[j * dst_stride + i] = src[i * src_stride + j];
+        }
+    }
+}
+
+#ifdef MRMR_TRANSPOSE_SSE2
+// Full 16x16 byte transpose: four rounds of interleaving 8, 16, 32 and 64-bit lanes.
+void transposeTile16(const std::uint8_t *src,
+                     std::size_t src_stride,
+                     std::uint8_t *dst,
+                     std::size_t dst_stride)
+{
+    __m128i r[16];
+    for (std::size_t i = 0; i < 16; ++i) {
+        r[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * src_stride));
+    }
+
+    __m128i t[16];
+    for (std::size_t i = 0; i < 8; ++i) {
+        t[i] = _mm_unpacklo_epi8(r[2 * i], r[2 * i + 1]);
+        t[i + 8] = _mm_unpackhi_epi8(r[2 * i], r[2 * i + 1]);
+    }
+    for (std::size_t h = 0; h < 16; h += 8) {
+        for (std::size_t i = 0; i < 4; ++i) {
+            r[h + i] = _mm_unpacklo_epi16(t[h + 2 * i], t[h + 2 * i + 1]);
+            r[h + i + 4] = _mm_unpackhi_epi16(t[h + 2 * i], t[h + 2 * i + 1]);
+        }
+    }
+    for (std::size_t q = 0; q < 16; q += 4) {
+        for (std::size_t i = 0; i < 2; ++i) {
+            t[q + i] = _mm_unpacklo_epi32(r[q + 2 * i], r[q + 2 * i + 1]);
+            t[q + i + 2] = _mm_unpackhi_epi32(r[q + 2 * i], r[q + 2 * i + 1]);
+        }
+    }
+    for (std::size_t p = 0; p < 16; p += 2) {
+        r[p] = _mm_unpacklo_epi64(t[p], t[p + 1]);
+        r[p + 1] = _mm_unpackhi_epi64(t[p], t[p + 1]);
+    }
+
+    // The halves are paired so that register j now holds column j.
+    for (std::size_t j = 0; j < 16; ++j) {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + j * dst_stride), r[j]);
+    }
+}
+#endif
+}  // namespace
+
+void transposeBlock(const std::uint8_t *src,
+                    std::size_t rows,
+                    std::size_t columns,
+                    std::size_t column_begin,
+                    std::size_t column_end,
+                    std::uint8_t *dst,
+                    std::size_t dst_stride)
+{
+    for (std::size_t j = column_begin; j < column_end; j += kTile) {
+        std::size_t tile_columns = std::min(kTile, column_end - j);
+        for (std::size_t i = 0; i < rows; i += kTile) {
+            std::size_t tile_rows = std::min(kTile, rows - i);
+            const std::uint8_t *tile_src = src + i * columns + j;
+            std::uint8_t *tile_dst = dst + j * dst_stride + i;
+#ifdef MRMR_TRANSPOSE_SSE2
+            if (tile_rows == kTile && tile_columns == kTile) {
+                transposeTile16(tile_src, columns, tile_dst, dst_stride);
+                continue;
+            }
+#endif
+            transposeTileScalar(tile_src, columns, tile_rows, tile_columns, tile_dst, dst_stride);
+        }
+    }
+}
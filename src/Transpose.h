@@ -0,0 +1,45 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Transposes a block of row-major samples into column-major storage.
+ *
+ * Copies columns [column_begin, column_end) of a rows x columns row-major block into dst, where
+ * column j of the block is written at dst + j * dst_stride. The work is split into 16x16 tiles
+ * so both the reads and the writes of a tile stay within a few cache lines, and full tiles are
+ * transposed in SSE2 registers when available.
+ *
+ * @param src Row-major block, rows * columns bytes
+ * @param rows Number of rows in the block
+ * @param columns Number of columns (bytes per row) in the block
+ * @param column_begin First column to transpose
+ * @param column_end One past the last column to transpose
+ * @param dst Destination of the first row of column 0
+ * @param dst_stride Distance between two destination columns
+ */
+void transposeBlock(const std::uint8_t *src,
+                    std::size_t rows,
+                    std::size_t columns,
+                    std::size_t column_begin,
+                    std::size_t column_end,
+                    std::uint8_t *dst,
+                    std::size_t dst_stride);
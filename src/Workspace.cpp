@@ -0,0 +1,93 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Workspace.h"
+
+#include <cstring>
+
+std::atomic<std::uint64_t> Workspace::allocations_{0};
+std::atomic<std::uint64_t> Workspace::reserved_bytes_{0};
+
+Workspace &Workspace::local()
+{
+    thread_local Workspace workspace;
+    return workspace;
+}
+
+// Returns the first size elements of a slot, growing it (the only allocation) when too small.
+template <typename T>
+std::span<T> Workspace::borrow(std::vector<T> &storage, std::size_t size, bool clear)
+{
+    if (storage.size() < size) {
+        std::size_t previous = storage.capacity();
+        storage.resize(size);
+        if (storage.capacity() != previous) {
+            allocations_.fetch_add(1, std::memory_order_relaxed);
+            reserved_bytes_.fetch_add((storage.capacity() - previous) * sizeof(T),
+                                      std::memory_order_relaxed);
+        }
+    }
+
+    if (clear && size > 0) {
+        std::memset(storage.data(), 0, size * sizeof(T));
+    }
+    return std::span<T>(storage.data(), size);
+}
+
+/**
+ * Borrows a zeroed count table from the given slot.
+ */
+std::span<std::uint32_t> Workspace::table(Table slot, std::size_t size)
+{
+    return borrow(tables_[static_cast<std::size_t>(slot)], size, true);
+}
+
+/**
+ * Borrows a zeroed table of 64-bit counts from the given slot, for counts that may exceed
+ * 2^32 - 1. It is separate from the 32-bit table of the same slot.
+ */
+std::span<std::uint64_t> Workspace::wideTable(Table slot, std::size_t size)
+{
+    return borrow(wide_tables_[static_cast<std::size_t>(slot)], size, true);
+}
+
+/**
+ * Borrows a zeroed buffer of reals from the given slot.
+ */
+std::span<double> Workspace::buffer(Buffer slot, std::size_t size)
+{
+    return borrow(buffers_[static_cast<std::size_t>(slot)], size, true);
+}
+
+/**
+ * Borrows an uninitialized byte buffer, used to materialize one feature.
+ */
+std::span<std::uint8_t> Workspace::column(Column slot, std::size_t size)
+{
+    return borrow(columns_[static_cast<std::size_t>(slot)], size, false);
+}
+
+// Number of times any thread had to grow one of its slots since the process started.
+std::uint64_t Workspace::allocations() noexcept
+{
+    return allocations_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t Workspace::reservedBytes() noexcept
+{
+    return reserved_bytes_.load(std::memory_order_relaxed);
+}
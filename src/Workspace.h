@@ -0,0 +1,75 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Per-thread scratch memory borrowed by JointProb, Histogram and MutualInfo. Each slot only
+// grows, and is cleared with memset when borrowed, so once the first few tables have been built
+// the selection loop runs without touching the allocator. A borrowed span stays valid until the
+// same slot is borrowed again on the same thread.
+class Workspace
+{
+  public:
+    enum class Table {
+        Joint,
+        Histogram,
+        Count
+    };
+
+    enum class Buffer {
+        Marginal1,
+        Marginal2,
+        Count
+    };
+
+    enum class Column {
+        First,
+        Second,
+        Third,
+        Count
+    };
+
+    static Workspace &local();
+
+    std::span<std::uint32_t> table(Table slot, std::size_t size);
+    std::span<std::uint64_t> wideTable(Table slot, std::size_t size);
+    std::span<double> buffer(Buffer slot, std::size_t size);
+    std::span<std::uint8_t> column(Column slot, std::size_t size);
+
+    static std::uint64_t allocations() noexcept;
+    static std::uint64_t reservedBytes() noexcept;
+
+  private:
+    Workspace() = default;
+
+    template <typename T>
+    static std::span<T> borrow(std::vector<T> &storage, std::size_t size, bool clear);
+
+    std::array<std::vector<std::uint32_t>, static_cast<std::size_t>(Table::Count)> tables_;
+    std::array<std::vector<std::uint64_t>, static_cast<std::size_t>(Table::Count)> wide_tables_;
+    std::array<std::vector<double>, static_cast<std::size_t>(Buffer::Count)> buffers_;
+    std::array<std::vector<std::uint8_t>, static_cast<std::size_t>(Column::Count)> columns_;
+
+    static std::atomic<std::uint64_t> allocations_;
+    static std::atomic<std::uint64_t> reserved_bytes_;
+};
@@ -20,11 +20,31 @@ set_warnings("allextra", "error")
 
 add_requires("vcpkg::arrow[parquet,csv]", {configs = {shared = true}, alias = "arrow"})
 
+-- Builds the fast_mrmr Python module: xmake f --python=y
+option("python")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Build the fast_mrmr Python module (requires the Python headers)")
+option_end()
+
+if has_config("python") then
+    add_requires("python 3.x")
+end
+
 -- Define the fast-mrmr_core core library
 target("fast-mrmr_core")
     set_kind("static")
     add_files("src/**.cpp")
     add_includedirs("src", {public = true})
+    if is_plat("windows") then
+        add_syslinks("psapi", {public = true})
+    elseif is_plat("linux") then
+        add_syslinks("pthread", {public = true})
+        if has_config("python") then
+            -- Linked into the Python module as well
+            add_cxflags("-fPIC")
+        end
+    end
 
 -- Define the fast-mrmr_cli application target
 target("fast-mrmr_cli")
@@ -33,6 +53,22 @@ target("fast-mrmr_cli")
     add_files("apps/fast-mrmr_cli.cpp")
     add_packages("arrow")
 
+-- Converts .mrmr files to the block-compressed columnar format
+target("mrmr_convert")
+    set_kind("binary")
+    add_deps("fast-mrmr_core")
+    add_files("apps/mrmr_convert.cpp")
+
+-- Python module running the selection in-process on NumPy arrays and pyarrow tables
+if has_config("python") then
+    target("fast_mrmr")
+        add_rules("python.library", {soabi = true})
+        add_deps("fast-mrmr_core")
+        add_files("python/fast_mrmr.cpp")
+        add_packages("python")
+    target_end()
+end
+
 target("csv_to_parquet")
     set_kind("binary")
     add_files("apps/csv_to_parquet.cpp")